@@ -0,0 +1,193 @@
+/**
+ * @file client.cpp
+ * @brief Example client of the modem-sharing daemon.
+ * @author Wilkins White
+ * @copyright 2024 Nova Dynamics LLC
+ *
+ * Usage: gsmc host port [control socket]
+ *
+ * Connects to 'host':'port' through the daemon, sends stdin and writes
+ * whatever the server returns to stdout.
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "gsmd.h"
+
+namespace {
+
+/**
+ * @brief Connect to the daemon and map the channel it passes back.
+ *
+ * @param [in] path - control socket path.
+ * @param [out] channel - mapped channel.
+ * @return control socket or -1 on failure.
+ */
+int attach(const char *path, gsmd::Channel *&channel)
+{
+    struct sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if(fd < 0)
+        return -1;
+
+    if(connect(fd, reinterpret_cast<struct sockaddr*>(&addr),
+            sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    gsmd::message_t msg;
+    struct iovec iov = { &msg, sizeof(msg) };
+    char control[CMSG_SPACE(sizeof(int))] = {};
+
+    struct msghdr hdr = {};
+    hdr.msg_iov = &iov;
+    hdr.msg_iovlen = 1;
+    hdr.msg_control = control;
+    hdr.msg_controllen = sizeof(control);
+
+    struct cmsghdr *cmsg = nullptr;
+    if(recvmsg(fd, &hdr, MSG_CMSG_CLOEXEC) != sizeof(msg)
+            || msg.notice != gsmd::Notice::attached
+            || (cmsg = CMSG_FIRSTHDR(&hdr)) == nullptr
+            || cmsg->cmsg_type != SCM_RIGHTS) {
+        errno = EPROTO;
+        close(fd);
+        return -1;
+    }
+
+    int mem;
+    memcpy(&mem, CMSG_DATA(cmsg), sizeof(int));
+
+    void *addr_map = mmap(nullptr, sizeof(gsmd::Channel),
+            PROT_READ | PROT_WRITE, MAP_SHARED, mem, 0);
+
+    close(mem);
+
+    if(addr_map == MAP_FAILED) {
+        close(fd);
+        return -1;
+    }
+
+    channel = static_cast<gsmd::Channel*>(addr_map);
+    return fd;
+}
+
+/** Write everything in the rx ring to stdout. */
+void drain(gsmd::Ring &ring)
+{
+    char buffer[1024];
+    size_t count;
+
+    while((count = ring.read(buffer, sizeof(buffer))) > 0)
+        fwrite(buffer, count, 1, stdout);
+
+    fflush(stdout);
+}
+
+} // namespace
+
+/** Application entry point. */
+int main(int argc, char *argv[])
+{
+    if(argc < 3) {
+        fprintf(stderr, "Usage: %s host port [control socket]\n", argv[0]);
+        exit(1);
+    }
+
+    const char *path = (argc > 3) ? argv[3] : gsmd::kControlPath;
+
+    gsmd::Channel *channel = nullptr;
+    int fd = attach(path, channel);
+    if(fd < 0) {
+        perror("Failed to attach to daemon");
+        exit(1);
+    }
+
+    gsmd::request_t req = {};
+    req.op = gsmd::Op::open;
+    req.port = atoi(argv[2]);
+    strncpy(req.host, argv[1], sizeof(req.host) - 1);
+    send(fd, &req, sizeof(req), MSG_NOSIGNAL);
+
+    gsmd::message_t msg;
+    if(recv(fd, &msg, sizeof(msg), 0) != sizeof(msg)
+            || msg.notice != gsmd::Notice::opened) {
+        fprintf(stderr, "Daemon closed the channel\n");
+        exit(1);
+    }
+
+    if(msg.result < 0) {
+        fprintf(stderr, "Failed to connect: %s\n", strerror(-msg.result));
+        exit(1);
+    }
+
+    fprintf(stderr, "Connected (handle %u)\n", msg.handle);
+
+    // Bytes read from stdin that did not fit in the tx ring yet
+    char pending[1024];
+    size_t pending_size = 0;
+    size_t pending_index = 0;
+    bool input = true;
+
+    while(true) {
+        struct pollfd fds[2] = {
+            { fd, POLLIN, 0 },
+            { STDIN_FILENO, POLLIN, 0 },
+        };
+
+        // Only read stdin when the previous chunk was written
+        const bool reading = input && pending_index == pending_size;
+        poll(fds, reading ? 2 : 1, reading ? -1 : 10);
+
+        if(fds[0].revents & POLLIN) {
+            if(recv(fd, &msg, sizeof(msg), 0) != sizeof(msg))
+                break;
+
+            if(msg.notice == gsmd::Notice::data)
+                drain(channel->rx);
+
+            if(msg.notice == gsmd::Notice::closed) {
+                drain(channel->rx);
+                break;
+            }
+        }
+        else if(fds[0].revents & (POLLHUP | POLLERR)) {
+            break;
+        }
+
+        if(reading && (fds[1].revents & (POLLIN | POLLHUP))) {
+            ssize_t count = read(STDIN_FILENO, pending, sizeof(pending));
+            if(count > 0) {
+                pending_size = count;
+                pending_index = 0;
+            }
+            else {
+                input = false;
+            }
+        }
+
+        if(pending_index < pending_size) {
+            pending_index += channel->tx.write(
+                    pending + pending_index, pending_size - pending_index);
+
+            req.op = gsmd::Op::kick;
+            send(fd, &req, sizeof(req), MSG_NOSIGNAL);
+        }
+    }
+
+    munmap(channel, sizeof(gsmd::Channel));
+    close(fd);
+    return 0;
+}
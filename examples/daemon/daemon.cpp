@@ -0,0 +1,424 @@
+/**
+ * @file daemon.cpp
+ * @brief Shares one modem between local processes.
+ * @author Wilkins White
+ * @copyright 2024 Nova Dynamics LLC
+ *
+ * Usage: gsmd [device] [apn] [control socket]
+ *
+ * @see gsmd.h for the client protocol.
+ */
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <new>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "gsmd.h"
+#include "modem.h"
+#include "serial.h"
+
+namespace {
+
+/** Maximum number of connected clients. */
+constexpr int kMaxClients = 16;
+
+/** Longest time to sleep between calls to Modem::process() (ms). */
+constexpr int kPollTimeout = 10;
+
+/** Interval between bring-up attempts (ms). */
+constexpr uint32_t kRetryInterval = 5000;
+
+/** Connected client. */
+struct Client {
+    int fd = -1; /**< Control socket. */
+    gsmd::Channel *channel = nullptr; /**< Shared rings. */
+};
+
+/** Serial port. */
+gsm::Serial serial;
+
+/** Set by the signal handler to stop the daemon. */
+volatile sig_atomic_t running = 1;
+
+/** Client slots. */
+Client clients[kMaxClients];
+
+/** Client holding the socket lease, or null. */
+Client *lease = nullptr;
+
+/** True while the lease holder's connection is being established. */
+bool opening = false;
+
+/** Handle of the current lease. */
+uint32_t lease_handle = 0;
+
+/** Staging buffers for Modem::send() and Modem::receive(). */
+uint8_t tx_buffer[gsm::kSocketMax];
+uint8_t rx_buffer[gsm::kSocketMax];
+
+void handle_signal(int)
+{
+    running = 0;
+}
+
+/**
+ * @brief Create the control socket.
+ *
+ * @param [in] path - socket path, replaced if it exists.
+ * @return file descriptor or -1 on failure.
+ */
+int open_control(const char *path)
+{
+    struct sockaddr_un addr = {};
+    if(strlen(path) >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(fd < 0)
+        return -1;
+
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    unlink(path);
+
+    if(bind(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0
+            || listen(fd, kMaxClients) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/** Send a message to a client, dropping it if the socket is full. */
+void notify(Client &client, gsmd::Notice notice, int result = 0)
+{
+    gsmd::message_t msg = {};
+    msg.notice = notice;
+    msg.result = result;
+    msg.handle = lease_handle;
+
+    send(client.fd, &msg, sizeof(msg), MSG_NOSIGNAL | MSG_DONTWAIT);
+}
+
+/** Release the lease, abandoning any transfer in progress. */
+void release_lease(gsm::Modem &modem)
+{
+    modem.stop_send();
+    modem.stop_receive();
+    lease = nullptr;
+    opening = false;
+}
+
+/** Disconnect a client and free its slot. */
+void drop_client(gsm::Modem &modem, Client &client)
+{
+    if(lease == &client) {
+        if(modem.connected())
+            modem.close();
+
+        release_lease(modem);
+    }
+
+    munmap(client.channel, sizeof(gsmd::Channel));
+    close(client.fd);
+    client.channel = nullptr;
+    client.fd = -1;
+}
+
+/** Accept a client and pass it a new channel. */
+void accept_client(int listen_fd)
+{
+    int fd = accept4(listen_fd, nullptr, nullptr,
+            SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+    if(fd < 0)
+        return;
+
+    Client *client = nullptr;
+    for(Client &c : clients) {
+        if(c.fd < 0) {
+            client = &c;
+            break;
+        }
+    }
+
+    int mem = memfd_create("gsmd", MFD_CLOEXEC);
+    if(client == nullptr || mem < 0
+            || ftruncate(mem, sizeof(gsmd::Channel)) < 0) {
+        if(mem >= 0)
+            close(mem);
+
+        close(fd);
+        return;
+    }
+
+    void *addr = mmap(nullptr, sizeof(gsmd::Channel),
+            PROT_READ | PROT_WRITE, MAP_SHARED, mem, 0);
+
+    if(addr == MAP_FAILED) {
+        close(mem);
+        close(fd);
+        return;
+    }
+
+    client->fd = fd;
+    client->channel = new (addr) gsmd::Channel();
+
+    // Pass the memfd along with the first message
+    gsmd::message_t msg = {};
+    msg.notice = gsmd::Notice::attached;
+
+    struct iovec iov = { &msg, sizeof(msg) };
+    char control[CMSG_SPACE(sizeof(int))] = {};
+
+    struct msghdr hdr = {};
+    hdr.msg_iov = &iov;
+    hdr.msg_iovlen = 1;
+    hdr.msg_control = control;
+    hdr.msg_controllen = sizeof(control);
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &mem, sizeof(int));
+
+    if(sendmsg(fd, &hdr, MSG_NOSIGNAL) < 0) {
+        munmap(addr, sizeof(gsmd::Channel));
+        close(fd);
+        client->channel = nullptr;
+        client->fd = -1;
+    }
+
+    close(mem);
+}
+
+/** Handle a request from a client. */
+void handle_request(gsm::Modem &modem, Client &client)
+{
+    gsmd::request_t req;
+    ssize_t count = recv(client.fd, &req, sizeof(req), 0);
+    if(count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return;
+
+    if(count != sizeof(req)) {
+        drop_client(modem, client);
+        return;
+    }
+
+    switch(req.op) {
+    case gsmd::Op::open: {
+        if(lease == &client) {
+            notify(client, gsmd::Notice::opened, -EALREADY);
+            break;
+        }
+
+        if(lease != nullptr) {
+            notify(client, gsmd::Notice::opened, -EBUSY);
+            break;
+        }
+
+        req.host[sizeof(req.host) - 1] = '\0';
+
+        int result = modem.connect(req.host, req.port);
+        if(result < 0) {
+            notify(client, gsmd::Notice::opened, result);
+            break;
+        }
+
+        // Drop anything left over from an earlier lease
+        gsmd::Channel &ch = *client.channel;
+        ch.tx.tail.store(ch.tx.head.load());
+
+        lease = &client;
+        lease_handle += 1;
+        opening = true;
+        break;
+    }
+    case gsmd::Op::close:
+        if(lease != &client)
+            break;
+
+        if(modem.connected())
+            modem.close();
+
+        release_lease(modem);
+        notify(client, gsmd::Notice::closed);
+        break;
+    case gsmd::Op::kick:
+        // The tx ring is drained every loop
+        break;
+    }
+}
+
+/** Move data between the lease holder's rings and the modem. */
+void service_lease(gsm::Modem &modem)
+{
+    if(lease == nullptr)
+        return;
+
+    if(opening) {
+        if(modem.connected()) {
+            opening = false;
+            notify(*lease, gsmd::Notice::opened);
+        }
+        else if(!modem.handshaking()) {
+            notify(*lease, gsmd::Notice::opened, -ECONNREFUSED);
+            release_lease(modem);
+        }
+        return;
+    }
+
+    if(!modem.connected()) {
+        notify(*lease, gsmd::Notice::closed, -ECONNRESET);
+        release_lease(modem);
+        return;
+    }
+
+    // Client to server
+    if(!modem.tx_busy()) {
+        const size_t count = lease->channel->tx.read(
+                tx_buffer, sizeof(tx_buffer));
+
+        if(count > 0)
+            modem.send(tx_buffer, count);
+    }
+
+    // Server to client
+    if(!modem.rx_busy()) {
+        gsmd::Ring &ring = lease->channel->rx;
+
+        const size_t count = modem.rx_count();
+        if(count > 0) {
+            ring.write(rx_buffer, count);
+            modem.stop_receive();
+            notify(*lease, gsmd::Notice::data);
+        }
+
+        const size_t size = std::min<size_t>(std::min<size_t>(
+                modem.rx_available(), ring.space()), sizeof(rx_buffer));
+
+        if(size > 0)
+            modem.receive(rx_buffer, size);
+    }
+}
+
+/** Bring the modem online, retrying periodically. */
+void bring_up(gsm::Modem &modem, const char *apn)
+{
+    static uint32_t timer = 0;
+
+    const uint32_t now = gsm::Serial::millis();
+    if((int32_t)(now - timer) < 0)
+        return;
+
+    switch(modem.status()) {
+    case gsm::State::ready:
+        modem.configure(apn);
+        break;
+    case gsm::State::registered:
+        modem.authenticate(apn);
+        break;
+    default:
+        return;
+    }
+
+    timer = now + kRetryInterval;
+}
+
+} // namespace
+
+/** Application entry point. */
+int main(int argc, char *argv[])
+{
+    const char *device = (argc > 1) ? argv[1] : "/dev/ttyUSB2";
+    const char *apn = (argc > 2) ? argv[2] : "hologram";
+    const char *path = (argc > 3) ? argv[3] : gsmd::kControlPath;
+
+    int result = serial.open(device);
+    if(result < 0) {
+        fprintf(stderr, "Failed to open serial port: %s\n", strerror(-result));
+        exit(1);
+    }
+
+    int listen_fd = open_control(path);
+    if(listen_fd < 0) {
+        perror("Failed to create control socket");
+        exit(1);
+    }
+
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+
+    gsm::context_t ctx = gsm::Serial::context();
+
+    gsm::Modem modem(ctx);
+
+    struct pollfd fds[kMaxClients + 2];
+    Client *owners[kMaxClients + 2];
+
+    while(running) {
+        int n = 0;
+
+        fds[n++] = { serial.fd(), POLLIN, 0 };
+        fds[n++] = { listen_fd, POLLIN, 0 };
+
+        for(Client &c : clients) {
+            if(c.fd >= 0) {
+                owners[n] = &c;
+                fds[n++] = { c.fd, POLLIN, 0 };
+            }
+        }
+
+        poll(fds, n, kPollTimeout);
+
+        if(fds[1].revents & POLLIN)
+            accept_client(listen_fd);
+
+        for(int i = 2; i < n; ++i) {
+            if(fds[i].revents & (POLLHUP | POLLERR))
+                drop_client(modem, *owners[i]);
+            else if(fds[i].revents & POLLIN)
+                handle_request(modem, *owners[i]);
+        }
+
+        modem.process();
+        bring_up(modem, apn);
+        service_lease(modem);
+    }
+
+    for(Client &c : clients) {
+        if(c.fd >= 0)
+            drop_client(modem, c);
+    }
+
+    close(listen_fd);
+    unlink(path);
+    serial.close();
+    return 0;
+}
+
+/**
+ * @brief Debug print function.
+ *
+ * Only required when the library is compiled with -DNOVAGSM_DEBUG flag
+ *
+ * @param [in] level the log level of the message.
+ * @param [in] str message c-string
+ */
+void gsm_debug(int level, const char *str)
+{
+    fprintf(stderr, "|%d| %s", level, str);
+}
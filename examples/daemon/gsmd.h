@@ -0,0 +1,145 @@
+/**
+ * @file gsmd.h
+ * @brief Protocol shared by the modem-sharing daemon and its clients.
+ * @author Wilkins White
+ * @copyright 2024 Nova Dynamics LLC
+ */
+
+#ifndef NOVAGSM_GSMD_H_
+#define NOVAGSM_GSMD_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * The daemon owns the serial port and a single gsm::Modem. Clients connect
+ * to a SOCK_SEQPACKET Unix domain socket and receive a shared memory
+ * channel (a memfd passed with SCM_RIGHTS) holding one ring per direction.
+ * Payload bytes only ever travel through the rings; the control socket
+ * carries small fixed size messages.
+ *
+ * The modem runs with AT+CIPMUX=0 so there is one TCP socket to share.
+ * A client that opens a connection holds a lease on it until it closes the
+ * connection, the server closes it or the client disconnects. Other
+ * clients are refused with -EBUSY in the meantime.
+ */
+namespace gsmd {
+
+/** Default control socket path. */
+constexpr const char *kControlPath = "/tmp/gsmd.sock";
+
+/** Capacity of each ring (bytes), must be a power of two. */
+constexpr uint32_t kRingSize = 16384;
+
+static_assert((kRingSize & (kRingSize - 1)) == 0, "power of two");
+
+/**
+ * @brief Single-producer single-consumer byte ring.
+ *
+ * Indices run freely and wrap modulo 2^32; the producer only writes
+ * 'head' and the consumer only writes 'tail'.
+ */
+struct Ring {
+    alignas(64) std::atomic<uint32_t> head; /**< Written by the producer. */
+    alignas(64) std::atomic<uint32_t> tail; /**< Written by the consumer. */
+    alignas(64) uint8_t data[kRingSize]; /**< Payload. */
+
+    /** Number of bytes waiting to be read. */
+    inline uint32_t used() const
+    {
+        return head.load(std::memory_order_acquire)
+            - tail.load(std::memory_order_acquire);
+    }
+
+    /** Number of bytes that can be written. */
+    inline uint32_t space() const
+    {
+        return kRingSize - used();
+    }
+
+    /**
+     * @brief Copy up to 'size' bytes into the ring (producer only).
+     *
+     * @return number of bytes written.
+     */
+    inline size_t write(const void *src, size_t size)
+    {
+        const uint32_t h = head.load(std::memory_order_relaxed);
+        const uint32_t t = tail.load(std::memory_order_acquire);
+        const uint8_t *p = static_cast<const uint8_t*>(src);
+
+        size = std::min<size_t>(size, kRingSize - (h - t));
+
+        const uint32_t offset = h & (kRingSize - 1);
+        const size_t first = std::min<size_t>(size, kRingSize - offset);
+        memcpy(data + offset, p, first);
+        memcpy(data, p + first, size - first);
+
+        head.store(h + size, std::memory_order_release);
+        return size;
+    }
+
+    /**
+     * @brief Copy up to 'size' bytes out of the ring (consumer only).
+     *
+     * @return number of bytes read.
+     */
+    inline size_t read(void *dst, size_t size)
+    {
+        const uint32_t t = tail.load(std::memory_order_relaxed);
+        const uint32_t h = head.load(std::memory_order_acquire);
+        uint8_t *p = static_cast<uint8_t*>(dst);
+
+        size = std::min<size_t>(size, h - t);
+
+        const uint32_t offset = t & (kRingSize - 1);
+        const size_t first = std::min<size_t>(size, kRingSize - offset);
+        memcpy(p, data + offset, first);
+        memcpy(p + first, data, size - first);
+
+        tail.store(t + size, std::memory_order_release);
+        return size;
+    }
+};
+
+/** Shared memory mapped by the daemon and one client. */
+struct Channel {
+    Ring rx; /**< Daemon to client. */
+    Ring tx; /**< Client to daemon. */
+};
+
+/** Client requests. */
+enum class Op : uint8_t {
+    open, /**< Take the lease and connect to 'host':'port'. */
+    close, /**< Close the connection and release the lease. */
+    kick, /**< New data was written to the tx ring. */
+};
+
+/** Request sent by a client. */
+typedef struct {
+    Op op; /**< Requested operation. */
+    uint16_t port; /**< Server port for Op::open. */
+    char host[64]; /**< Server address for Op::open. */
+} request_t;
+
+/** Daemon notices. */
+enum class Notice : uint8_t {
+    attached, /**< Channel attached, carries the memfd. */
+    opened, /**< Result of Op::open. */
+    closed, /**< The connection was closed, the lease is released. */
+    data, /**< New data was written to the rx ring. */
+};
+
+/** Message sent by the daemon. */
+typedef struct {
+    Notice notice; /**< Message type. */
+    int32_t result; /**< 0 or a negative error code. */
+    uint32_t handle; /**< Virtual socket handle of the lease. */
+} message_t;
+
+} // namespace gsmd
+
+#endif // NOVAGSM_GSMD_H_
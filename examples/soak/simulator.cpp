@@ -0,0 +1,393 @@
+/**
+ * @file simulator.cpp
+ * @brief Simulated SIM7000 for the soak test.
+ * @author Wilkins White
+ * @copyright 2024 Nova Dynamics LLC
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#include "simulator.h"
+
+namespace {
+
+/** Bytes per millisecond at 115200 baud, 8N1. */
+constexpr uint32_t kBytesPerMs = 11;
+
+/** Most bytes buffered between reads (UART FIFO and driver). */
+constexpr uint32_t kBudgetMax = 1024;
+
+/** Socket buffer reported by AT+CIPSEND? (bytes). */
+constexpr int kSendBuffer = 1460;
+
+} // namespace
+
+Simulator::Simulator(uint32_t seed) : seed(seed ? seed : 1)
+{
+}
+
+uint32_t Simulator::random()
+{
+    // xorshift32
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+uint32_t Simulator::delay(uint32_t min, uint32_t max)
+{
+    return min + random() % (max - min + 1);
+}
+
+void Simulator::reply(const std::string &text, uint32_t after)
+{
+    output.push_back({ now + after, text });
+}
+
+void Simulator::defer(const std::string &text, uint32_t after)
+{
+    deferred.push_back({ now + after, text });
+}
+
+void Simulator::advance(uint32_t time)
+{
+    budget = std::min(budget + (time - budget_time) * kBytesPerMs, kBudgetMax);
+    budget_time = time;
+    now = time;
+
+    if(booting && (int32_t)(now - boot_end) >= 0) {
+        booting = false;
+        reply("\r\nRDY\r\n\r\n+CFUN: 1\r\n\r\n+CPIN: READY\r\n"
+            "\r\nSMS Ready\r\n", 0);
+    }
+
+    if(!registered && (int32_t)(now - outage_end) >= 0) {
+        registered = true;
+        if(!booting && !stalled)
+            reply("\r\n+CREG: 1\r\n\r\n+CEREG: 1\r\n", 0);
+    }
+
+    // Echoed data reaches the server after the round trip
+    while(!in_flight.empty() && (int32_t)(now - in_flight.front().due) >= 0) {
+        if(socket) {
+            if(server.empty())
+                reply("\r\n+CIPRXGET: 1\r\n", 0);
+
+            server += in_flight.front().text;
+        }
+
+        in_flight.pop_front();
+    }
+}
+
+int Simulator::read(void *data, size_t size)
+{
+    uint8_t *p = static_cast<uint8_t*>(data);
+    size_t count = 0;
+
+    while(count < size && budget > 0 && !output.empty()) {
+        Reply &front = output.front();
+        if((int32_t)(now - front.due) < 0)
+            break;
+
+        const size_t n = std::min<size_t>(
+            std::min<size_t>(size - count, budget), front.text.size());
+
+        memcpy(p + count, front.text.data(), n);
+        front.text.erase(0, n);
+        count += n;
+        budget -= n;
+
+        if(front.text.empty())
+            output.pop_front();
+    }
+
+    return count;
+}
+
+int Simulator::write(const void *data, size_t size)
+{
+    const char *p = static_cast<const char*>(data);
+
+    for(size_t i = 0; i < size; ++i) {
+        if(payload_left > 0) {
+            payload += p[i];
+            if(--payload_left == 0)
+                handle_payload();
+        }
+        else if(p[i] == '\r') {
+            handle_line(line);
+            line.clear();
+        }
+        else if(p[i] != '\n') {
+            line += p[i];
+        }
+    }
+
+    return size;
+}
+
+void Simulator::drop_socket()
+{
+    if(!socket)
+        return;
+
+    close_socket();
+    reply("\r\nCLOSED\r\n", 0);
+}
+
+void Simulator::deactivate()
+{
+    if(!pdp)
+        return;
+
+    pdp = false;
+    close_socket();
+    reply("\r\n+PDP: DEACT\r\n", 0);
+}
+
+void Simulator::lose_network(uint32_t duration)
+{
+    registered = false;
+    outage_end = now + duration;
+
+    const bool active = pdp;
+    pdp = false;
+    close_socket();
+
+    reply("\r\n+CREG: 2\r\n\r\n+CEREG: 2\r\n", 0);
+    if(active)
+        reply("\r\n+PDP: DEACT\r\n", 0);
+}
+
+void Simulator::stall()
+{
+    stalled = true;
+}
+
+void Simulator::hard_reset()
+{
+    stalled = false;
+    reboot();
+}
+
+void Simulator::storm(unsigned int count)
+{
+    static const char *const kReports[] = {
+        "\r\n+CREG: 1\r\n",
+        "\r\n*PSUTTZ: 24/06/12,10:30:15\",\"-28\",0\r\n",
+        "\r\nDST: 0\r\n",
+        "\r\n+CTZV: -28,0\r\n",
+        "\r\nSMS Ready\r\n",
+        "\r\n+CIPRXGET: 1\r\n",
+    };
+
+    constexpr size_t kCount = sizeof(kReports) / sizeof(kReports[0]);
+
+    for(unsigned int i = 0; i < count; ++i) {
+        const size_t n = random() % kCount;
+
+        // Only report data that is really there
+        if(n == kCount - 1 && server.empty())
+            continue;
+
+        if(n == 0 && !registered)
+            continue;
+
+        reply(kReports[n], 0);
+    }
+}
+
+void Simulator::close_socket()
+{
+    // Data still on the way belongs to the old connection
+    socket = false;
+    server.clear();
+    in_flight.clear();
+}
+
+void Simulator::reboot()
+{
+    output.clear();
+    payload_left = 0;
+    line.clear();
+
+    pdp = false;
+    close_socket();
+    booting = true;
+    boot_end = now + delay(1500, 3000);
+}
+
+void Simulator::handle_line(const std::string &text)
+{
+    if(stalled || booting)
+        return;
+
+    if(text.compare(0, 2, "AT") != 0)
+        return;
+
+    // Commands may be chained with ';'
+    response.clear();
+    bool ok = true;
+    size_t start = 2;
+
+    for(;;) {
+        const size_t end = text.find(';', start);
+        ok &= handle(text.substr(start, end - start));
+        if(end == std::string::npos)
+            break;
+
+        start = end + 1;
+    }
+
+    if(ok)
+        response += "\r\nOK\r\n";
+
+    if(!response.empty())
+        reply(response, delay(1, 5));
+
+    // Results that follow the command response, e.g. 'CONNECT OK'
+    for(const Reply &r : deferred)
+        output.push_back(r);
+
+    deferred.clear();
+}
+
+bool Simulator::handle(const std::string &cmd)
+{
+    if(cmd == "+CFUN=1,1") {
+        reboot();
+        return true;
+    }
+
+    // Registration status
+    const std::string stat = (registered) ? "1" : "2";
+
+    if(cmd == "+CFUN?") {
+        response += "\r\n+CFUN: 1\r\n";
+    }
+    else if(cmd == "+CPIN?") {
+        response += "\r\n+CPIN: READY\r\n";
+    }
+    else if(cmd == "+CMEE?") {
+        response += "\r\n+CMEE: 1\r\n";
+    }
+    else if(cmd == "+CSQ") {
+        response += (registered) ? "\r\n+CSQ: 18,0\r\n" : "\r\n+CSQ: 99,99\r\n";
+    }
+    else if(cmd == "+CREG?") {
+        response += "\r\n+CREG: 2," + stat + "\r\n";
+    }
+    else if(cmd == "+CGREG?") {
+        response += "\r\n+CGREG: 0," + stat + "\r\n";
+    }
+    else if(cmd == "+CEREG?") {
+        response += "\r\n+CEREG: 2," + stat + "\r\n";
+    }
+    else if(cmd == "+CGATT?") {
+        response += (registered) ? "\r\n+CGATT: 1\r\n" : "\r\n+CGATT: 0\r\n";
+    }
+    else if(cmd == "+CIPSHUT") {
+        pdp = false;
+        close_socket();
+    }
+    else if(cmd == "+CIICR") {
+        if(!registered) {
+            defer("\r\nERROR\r\n", delay(500, 1000));
+            return false;
+        }
+
+        pdp = true;
+        defer("\r\nOK\r\n", delay(500, 3000));
+        return false;
+    }
+    else if(cmd == "+CIFSR") {
+        response += (pdp) ? "\r\n10.170.4.21\r\n" : "\r\nERROR\r\n";
+        return false;
+    }
+    else if(cmd.compare(0, 10, "+CIPSTART=") == 0) {
+        response += "\r\nOK\r\n";
+        if(socket) {
+            defer("\r\nALREADY CONNECT\r\n", delay(5, 20));
+        }
+        else if(pdp) {
+            socket = true;
+            defer("\r\nCONNECT OK\r\n", delay(100, 800));
+        }
+        else {
+            defer("\r\nCONNECT FAIL\r\n", delay(100, 800));
+        }
+        return false;
+    }
+    else if(cmd.compare(0, 9, "+CIPCLOSE") == 0) {
+        if(!socket) {
+            response += "\r\nERROR\r\n";
+            return false;
+        }
+
+        close_socket();
+        defer("\r\nCLOSE OK\r\n", delay(50, 200));
+        return false;
+    }
+    else if(cmd == "+CIPSEND?") {
+        if(!socket) {
+            response += "\r\nERROR\r\n";
+            return false;
+        }
+
+        response += "\r\n+CIPSEND: " + std::to_string(kSendBuffer) + "\r\n";
+    }
+    else if(cmd.compare(0, 9, "+CIPSEND=") == 0) {
+        // Payload follows the prompt, even if the socket is gone
+        payload.clear();
+        payload_left = strtoul(cmd.c_str() + 9, nullptr, 10);
+        response += "\r\n> ";
+        return false;
+    }
+    else if(cmd == "+CIPRXGET=4") {
+        if(!socket) {
+            response += "\r\nERROR\r\n";
+            return false;
+        }
+
+        response += "\r\n+CIPRXGET: 4,"
+            + std::to_string(server.size()) + "\r\n";
+    }
+    else if(cmd.compare(0, 12, "+CIPRXGET=2,") == 0) {
+        if(!socket) {
+            response += "\r\nERROR\r\n";
+            return false;
+        }
+
+        size_t n = strtoul(cmd.c_str() + 12, nullptr, 10);
+        n = std::min(n, server.size());
+
+        const std::string data = server.substr(0, n);
+        server.erase(0, n);
+
+        response += "\r\n+CIPRXGET: 2," + std::to_string(n) + ","
+            + std::to_string(server.size()) + "\r\n" + data + "\r\n";
+    }
+
+    // Everything else, e.g. the initialization sequence, is accepted
+    return true;
+}
+
+void Simulator::handle_payload()
+{
+    if(stalled || booting)
+        return;
+
+    if(!socket) {
+        reply("\r\nERROR\r\n", delay(1, 5));
+        return;
+    }
+
+    const uint32_t rtt = delay(40, 250);
+    reply("\r\nSEND OK\r\n", rtt);
+    in_flight.push_back({ now + rtt + delay(40, 250), payload });
+    echo_total += payload.size();
+}
@@ -0,0 +1,185 @@
+/**
+ * @file simulator.h
+ * @brief Simulated SIM7000 for the soak test.
+ * @author Wilkins White
+ * @copyright 2024 Nova Dynamics LLC
+ */
+
+#ifndef NOVAGSM_SOAK_SIMULATOR_H_
+#define NOVAGSM_SOAK_SIMULATOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Just enough of a SIM7000 to run the driver for days.
+ *
+ * Answers the commands the driver issues with plausible delays, limits the
+ * serial link to 115200 baud and echoes socket data back like a TCP echo
+ * server. Faults are injected by the soak loop: dropped sockets, PDP
+ * deactivation, loss of service, a stalled modem and URC storms.
+ *
+ * Time is driven by advance() so a day runs in a few minutes.
+ */
+class Simulator {
+public:
+    /**
+     * @brief Constructor.
+     *
+     * @param [in] seed - random seed for reply delays.
+     */
+    explicit Simulator(uint32_t seed);
+
+    /**
+     * @brief Move the clock forward.
+     *
+     * @param [in] now - current time (ms).
+     */
+    void advance(uint32_t now);
+
+    /** context_t::read for the driver. */
+    int read(void *data, size_t size);
+
+    /** context_t::write for the driver. */
+    int write(const void *data, size_t size);
+
+    /** Close the socket from the server side ('CLOSED'). */
+    void drop_socket();
+
+    /** Deactivate the data connection ('+PDP: DEACT'). */
+    void deactivate();
+
+    /**
+     * @brief Lose network service.
+     *
+     * @param [in] duration - time until service returns (ms).
+     */
+    void lose_network(uint32_t duration);
+
+    /**
+     * @brief Stop answering until hard_reset().
+     */
+    void stall();
+
+    /** context_t::hard_reset for the driver. */
+    void hard_reset();
+
+    /**
+     * @brief Emit a burst of unsolicited reports.
+     *
+     * @param [in] count - number of reports.
+     */
+    void storm(unsigned int count);
+
+    /**
+     * @brief Total number of bytes echoed by the server.
+     */
+    inline uint64_t echoed() const
+    {
+        return echo_total;
+    }
+
+private:
+    /** Text the modem will write once 'due' has passed. */
+    struct Reply {
+        uint32_t due; /**< Time the text becomes readable. */
+        std::string text; /**< Text to write. */
+    };
+
+    /** Returns a pseudo-random number. */
+    uint32_t random();
+
+    /** Returns a delay between 'min' and 'max' (ms). */
+    uint32_t delay(uint32_t min, uint32_t max);
+
+    /** Queue text to be read after 'after' ms. */
+    void reply(const std::string &text, uint32_t after = 1);
+
+    /** Queue text to follow the response of the current line. */
+    void defer(const std::string &text, uint32_t after);
+
+    /**
+     * @brief Handle one command of an AT line.
+     *
+     * @param [in] cmd - command without the "AT" prefix.
+     * @return false if the final 'OK' is sent later or not at all.
+     */
+    bool handle(const std::string &cmd);
+
+    /** Handle a complete line from the driver. */
+    void handle_line(const std::string &line);
+
+    /** Handle the payload of AT+CIPSEND. */
+    void handle_payload();
+
+    /** Close the socket, dropping data not yet read. */
+    void close_socket();
+
+    /** Restart, announcing 'RDY' when done. */
+    void reboot();
+
+    /** Current time (ms). */
+    uint32_t now = 0;
+
+    /** Random state. */
+    uint32_t seed;
+
+    /** Output not yet read. */
+    std::deque<Reply> output;
+
+    /** Bytes the serial link can carry before the next read. */
+    uint32_t budget = 0;
+
+    /** Time the budget was last refilled. */
+    uint32_t budget_time = 0;
+
+    /** Line being received. */
+    std::string line;
+
+    /** AT+CIPSEND payload being received. */
+    std::string payload;
+
+    /** Bytes of payload still expected. */
+    size_t payload_left = 0;
+
+    /** Data waiting on the echo server. */
+    std::string server;
+
+    /** Echoed data not yet on the server, waiting out the round trip. */
+    std::deque<Reply> in_flight;
+
+    /** Total number of bytes echoed. */
+    uint64_t echo_total = 0;
+
+    /** True while registered on the network. */
+    bool registered = true;
+
+    /** Time service returns after lose_network(). */
+    uint32_t outage_end = 0;
+
+    /** True while the data connection is active. */
+    bool pdp = false;
+
+    /** True while the socket is open. */
+    bool socket = false;
+
+    /** True while ignoring the driver. */
+    bool stalled = false;
+
+    /** True while rebooting, until 'RDY'. */
+    bool booting = false;
+
+    /** Time the reboot finishes. */
+    uint32_t boot_end = 0;
+
+    /** Response being built by handle(). */
+    std::string response;
+
+    /** Replies queued by handle() to follow the response. */
+    std::vector<Reply> deferred;
+};
+
+#endif // NOVAGSM_SOAK_SIMULATOR_H_
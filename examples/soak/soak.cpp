@@ -0,0 +1,631 @@
+/**
+ * @file soak.cpp
+ * @brief Long-duration soak test against a simulated modem.
+ * @author Wilkins White
+ * @copyright 2024 Nova Dynamics LLC
+ *
+ * Usage: gsm_soak [hours] [seed]
+ *
+ * Runs the driver for simulated hours (default 72) of connects, transfers
+ * and injected faults, printing one row per hour:
+ *
+ *     heap   - lowest heap held by the driver during the hour (bytes)
+ *     allocs - allocations made by the driver
+ *     /write - allocations per serial write
+ *     queue  - peak and mean command queue depth
+ *     p50, p99, p99.9, max - wall time of Modem::process() (us), not
+ *              counting the simulator
+ *     KB/s   - echo throughput in simulated time
+ *     conn, reg, wdg - connections opened, registrations, watchdog resets
+ *
+ * Hours are compared with the first hour after start up. Growth in heap,
+ * allocations per serial write, queue depth or p99 latency, or a drop in
+ * throughput, is flagged as drift and the program exits with status 1.
+ * Allocations are counted per write because outages and reconnects change
+ * how many commands an hour sends, not how much each one costs.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <new>
+
+#include "debug.h"
+#include "modem.h"
+#include "simulator.h"
+
+namespace {
+
+/** Length of a report window (ms). */
+constexpr uint32_t kWindow = 3600000;
+
+/** Time the driver is given to start up before the baseline (ms). */
+constexpr uint32_t kWarmup = kWindow;
+
+/** Interval between bring-up attempts (ms). */
+constexpr uint32_t kRetryInterval = 5000;
+
+/** Largest echo request (bytes). */
+constexpr size_t kMaxRequest = 4096;
+
+/** Heap growth over the baseline flagged as drift (bytes). */
+constexpr int64_t kHeapSlack = 1024;
+
+/** Queue depth growth over the baseline flagged as drift. */
+constexpr size_t kQueueSlack = 8;
+
+/** Histogram sub-buckets per power of two. */
+constexpr int kSubBuckets = 8;
+
+/** Number of histogram buckets. */
+constexpr int kBuckets = 2 * kSubBuckets + 60 * kSubBuckets;
+
+/** Mean interval between each fault (ms). */
+constexpr uint32_t kStormInterval = 5 * 60000;
+constexpr uint32_t kDropInterval = 20 * 60000;
+constexpr uint32_t kDeactInterval = 60 * 60000;
+constexpr uint32_t kOutageInterval = 4 * 60 * 60000;
+constexpr uint32_t kStallInterval = 8 * 60 * 60000;
+
+/** Heap usage attributed to the driver. */
+struct Heap {
+    bool driver = false; /**< True while the driver is running. */
+    uint64_t allocs = 0; /**< Allocations made by the driver. */
+    int64_t bytes = 0; /**< Bytes held by the driver. */
+};
+
+/** Header placed before every allocation. */
+struct alignas(16) Block {
+    size_t size; /**< Requested size. */
+    bool driver; /**< Allocated by the driver. */
+};
+
+/**
+ * @brief Log-linear latency histogram.
+ *
+ * Values are grouped in kSubBuckets buckets per power of two, so
+ * percentiles are within about 12%.
+ */
+class Histogram {
+public:
+    /** Record a value. */
+    void add(uint64_t value)
+    {
+        counts[bucket(value)] += 1;
+        total += 1;
+        peak = std::max(peak, value);
+    }
+
+    /** Returns the value below which 'p' (0-1) of the samples fall. */
+    uint64_t percentile(double p) const
+    {
+        const uint64_t target = (uint64_t)(p * total);
+        uint64_t sum = 0;
+
+        for(int i = 0; i < kBuckets; ++i) {
+            sum += counts[i];
+            if(sum > target)
+                return floor(i);
+        }
+
+        return peak;
+    }
+
+    /** Returns the largest value recorded. */
+    uint64_t max() const
+    {
+        return peak;
+    }
+
+private:
+    /** Returns the bucket holding 'value'. */
+    static int bucket(uint64_t value)
+    {
+        if(value < 2 * kSubBuckets)
+            return value;
+
+        int msb = 0;
+        while((value >> (msb + 1)) != 0)
+            msb += 1;
+
+        const int sub = (value >> (msb - 3)) & (kSubBuckets - 1);
+        return 2 * kSubBuckets + (msb - 4) * kSubBuckets + sub;
+    }
+
+    /** Returns the smallest value in bucket 'index'. */
+    static uint64_t floor(int index)
+    {
+        if(index < 2 * kSubBuckets)
+            return index;
+
+        const int msb = (index - 2 * kSubBuckets) / kSubBuckets + 4;
+        const int sub = (index - 2 * kSubBuckets) % kSubBuckets;
+        return (uint64_t)(kSubBuckets + sub) << (msb - 3);
+    }
+
+    uint64_t counts[kBuckets] = {};
+    uint64_t total = 0;
+    uint64_t peak = 0;
+};
+
+/** Statistics for one report window. */
+struct Window {
+    Histogram latency; /**< Modem::process() time (ns). */
+    uint64_t allocs = 0; /**< Driver allocations. */
+    uint64_t writes = 0; /**< Serial writes by the driver. */
+    int64_t heap = INT64_MAX; /**< Lowest driver heap usage (bytes). */
+    size_t queue_max = 0; /**< Peak command queue depth. */
+    uint64_t queue_sum = 0; /**< Sum of queue depth samples. */
+    uint64_t ticks = 0; /**< Number of samples. */
+    uint64_t echoed = 0; /**< Bytes echoed and verified. */
+    unsigned int connects = 0; /**< Connections opened. */
+    unsigned int registrations = 0; /**< Registrations. */
+    unsigned int watchdogs = 0; /**< Watchdog resets. */
+    unsigned int corrupt = 0; /**< Echo mismatches. */
+};
+
+/** Simulated clock (ms). */
+uint32_t now = 0;
+
+/** Simulated modem. */
+Simulator *sim = nullptr;
+
+/** Serial writes by the driver. */
+uint64_t writes = 0;
+
+/** Driver heap usage. */
+Heap heap;
+
+/** Wall time spent in the simulator during the current call (ns). */
+uint64_t sim_ns = 0;
+
+/** Current report window. */
+Window window;
+
+/** Echo request buffer. */
+uint8_t tx_buffer[kMaxRequest];
+
+/** Echo response buffer. */
+uint8_t rx_buffer[1024];
+
+/** Size of the echo request in flight, or 0. */
+size_t request = 0;
+
+/** Bytes of the echo response checked so far. */
+size_t response = 0;
+
+/** Request counter, varies the payload. */
+uint32_t sequence = 0;
+
+/** Returns a monotonic time stamp (ns). */
+uint64_t wall_ns()
+{
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(
+        steady_clock::now().time_since_epoch()).count();
+}
+
+/** Runs the simulator outside of the driver's accounting. */
+class Outside {
+public:
+    Outside() : driver(heap.driver), start(wall_ns())
+    {
+        heap.driver = false;
+    }
+
+    ~Outside()
+    {
+        heap.driver = driver;
+        sim_ns += wall_ns() - start;
+    }
+
+private:
+    bool driver;
+    uint64_t start;
+};
+
+/** Runs a driver call inside the driver's accounting. */
+class Inside {
+public:
+    Inside()
+    {
+        heap.driver = true;
+    }
+
+    ~Inside()
+    {
+        heap.driver = false;
+    }
+};
+
+int sim_read(void *data, size_t size)
+{
+    Outside outside;
+    return sim->read(data, size);
+}
+
+int sim_write(const void *data, size_t size)
+{
+    Outside outside;
+    writes += 1;
+    return sim->write(data, size);
+}
+
+uint32_t sim_millis()
+{
+    return now;
+}
+
+void sim_hard_reset()
+{
+    Outside outside;
+    sim->hard_reset();
+}
+
+void handle_state(gsm::State state, void *)
+{
+    if(state == gsm::State::open)
+        window.connects += 1;
+    else if(state == gsm::State::registered)
+        window.registrations += 1;
+}
+
+void handle_event(gsm::Event event, void *)
+{
+    if(event == gsm::Event::watchdog)
+        window.watchdogs += 1;
+}
+
+/** Returns a pseudo-random number. */
+uint32_t rand32(uint32_t &state)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+/** Returns a time about 'mean' ms from now. */
+uint32_t next(uint32_t &state, uint32_t mean)
+{
+    return now + mean / 2 + rand32(state) % mean;
+}
+
+/** Bring the modem online and keep an echo request going. */
+void run_app(gsm::Modem &modem, uint32_t &state)
+{
+    static uint32_t retry = 0;
+    Inside inside;
+
+    if(modem.status() != gsm::State::open) {
+        request = 0;
+
+        if((int32_t)(now - retry) < 0)
+            return;
+
+        switch(modem.status()) {
+        case gsm::State::ready:
+            modem.configure("soak");
+            break;
+        case gsm::State::registered:
+            modem.authenticate("soak");
+            break;
+        case gsm::State::online:
+            modem.connect("echo.example.com", 7);
+            break;
+        default:
+            return;
+        }
+
+        retry = now + kRetryInterval;
+        return;
+    }
+
+    if(request == 0 && !modem.tx_busy()) {
+        request = 256 + rand32(state) % (kMaxRequest - 256);
+        response = 0;
+        sequence += 1;
+
+        for(size_t i = 0; i < request; ++i)
+            tx_buffer[i] = (uint8_t)(sequence + i * 31);
+
+        modem.send(tx_buffer, request);
+    }
+
+    if(modem.rx_busy())
+        return;
+
+    const size_t count = modem.rx_count();
+    if(count > 0) {
+        if(response + count > request
+                || memcmp(rx_buffer, tx_buffer + response, count) != 0) {
+            window.corrupt += 1;
+        }
+
+        response += count;
+        modem.stop_receive();
+
+        if(response >= request) {
+            window.echoed += request;
+            request = 0;
+        }
+    }
+
+    const size_t size = std::min<size_t>(
+        modem.rx_available(), sizeof(rx_buffer));
+
+    if(size > 0)
+        modem.receive(rx_buffer, size);
+}
+
+/** Inject faults on their schedules. */
+void run_faults(uint32_t &state)
+{
+    static uint32_t storm = 0, drop = 0, deact = 0, outage = 0, stall = 0;
+
+    if(storm == 0) {
+        storm = next(state, kStormInterval);
+        drop = next(state, kDropInterval);
+        deact = next(state, kDeactInterval);
+        outage = next(state, kOutageInterval);
+        stall = next(state, kStallInterval);
+    }
+
+    Outside outside;
+
+    if((int32_t)(now - storm) >= 0) {
+        sim->storm(50 + rand32(state) % 250);
+        storm = next(state, kStormInterval);
+    }
+
+    if((int32_t)(now - drop) >= 0) {
+        sim->drop_socket();
+        drop = next(state, kDropInterval);
+    }
+
+    if((int32_t)(now - deact) >= 0) {
+        sim->deactivate();
+        deact = next(state, kDeactInterval);
+    }
+
+    if((int32_t)(now - outage) >= 0) {
+        sim->lose_network(10000 + rand32(state) % 50000);
+        outage = next(state, kOutageInterval);
+    }
+
+    if((int32_t)(now - stall) >= 0) {
+        sim->stall();
+        stall = next(state, kStallInterval);
+    }
+}
+
+/**
+ * @brief Print a window and compare it with the baseline.
+ *
+ * @return true if the window drifted.
+ */
+bool report(unsigned int hour, const Window &w, const Window *base)
+{
+    char drift[64] = "";
+
+    if(base) {
+        if(w.heap > base->heap + kHeapSlack)
+            strcat(drift, " heap");
+
+        // w.allocs / w.writes > 1.5 * base->allocs / base->writes
+        if(2 * w.allocs * base->writes > 3 * base->allocs * w.writes)
+            strcat(drift, " allocs");
+
+        if(w.queue_max > base->queue_max + kQueueSlack)
+            strcat(drift, " queue");
+
+        const uint64_t p99 = w.latency.percentile(0.99);
+        const uint64_t base_p99 = base->latency.percentile(0.99);
+        if(p99 > 2 * base_p99 && p99 > base_p99 + 2000)
+            strcat(drift, " latency");
+
+        if(w.echoed < base->echoed / 2)
+            strcat(drift, " throughput");
+    }
+
+    if(w.corrupt > 0)
+        strcat(drift, " data");
+
+    printf("%4u %7lld %7llu %6.2f %3lu/%-4.1f %6.1f %6.1f %6.1f %7.1f %6.2f"
+        " %4u %3u %3u %s\n",
+        hour,
+        (long long) w.heap,
+        (unsigned long long) w.allocs,
+        (double) w.allocs / std::max<uint64_t>(w.writes, 1),
+        (unsigned long) w.queue_max,
+        (double) w.queue_sum / std::max<uint64_t>(w.ticks, 1),
+        w.latency.percentile(0.5) / 1000.0,
+        w.latency.percentile(0.99) / 1000.0,
+        w.latency.percentile(0.999) / 1000.0,
+        w.latency.max() / 1000.0,
+        w.echoed / (kWindow / 1000.0) / 1024.0,
+        w.connects, w.registrations, w.watchdogs,
+        (drift[0]) ? drift + 1 : "-");
+
+    fflush(stdout);
+    return drift[0] != '\0';
+}
+
+} // namespace
+
+void *operator new(size_t size)
+{
+    Block *block = static_cast<Block*>(malloc(sizeof(Block) + size));
+    if(block == nullptr)
+        throw std::bad_alloc();
+
+    block->size = size;
+    block->driver = heap.driver;
+
+    if(heap.driver) {
+        heap.allocs += 1;
+        heap.bytes += size;
+    }
+
+    return block + 1;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    try {
+        return operator new(size);
+    }
+    catch(const std::bad_alloc&) {
+        return nullptr;
+    }
+}
+
+void *operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    return operator new(size, std::nothrow);
+}
+
+void operator delete(void *ptr) noexcept
+{
+    if(ptr == nullptr)
+        return;
+
+    Block *block = static_cast<Block*>(ptr) - 1;
+    if(block->driver)
+        heap.bytes -= block->size;
+
+    free(block);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+    operator delete(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t&) noexcept
+{
+    operator delete(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t&) noexcept
+{
+    operator delete(ptr);
+}
+
+/** Application entry point. */
+int main(int argc, char *argv[])
+{
+    const unsigned int hours = (argc > 1) ? strtoul(argv[1], nullptr, 10) : 72;
+    uint32_t state = (argc > 2) ? strtoul(argv[2], nullptr, 10) : 1;
+    if(state == 0)
+        state = 1;
+
+    Simulator simulator(state);
+    sim = &simulator;
+
+    gsm::context_t ctx = {};
+    ctx.read = sim_read;
+    ctx.write = sim_write;
+    ctx.millis = sim_millis;
+    ctx.hard_reset = sim_hard_reset;
+
+    gsm::Modem *modem = nullptr;
+    {
+        Inside inside;
+        modem = new gsm::Modem(ctx);
+    }
+
+    modem->set_state_callback(handle_state);
+    modem->set_event_callback(handle_event);
+
+    printf("hour    heap  allocs /write queue    p50    p99  p99.9     max"
+        "   KB/s conn reg wdg drift\n");
+
+    Window baseline;
+    bool have_baseline = false;
+    bool drifted = false;
+
+    const uint64_t start = wall_ns();
+    uint32_t window_end = kWindow;
+
+    for(unsigned int hour = 1; hour <= hours; ) {
+        now += 1;
+
+        {
+            Outside outside;
+            simulator.advance(now);
+        }
+
+        run_faults(state);
+
+        // Time Modem::process() without the simulator
+        sim_ns = 0;
+        const uint64_t t0 = wall_ns();
+        {
+            Inside inside;
+            modem->process();
+        }
+        const uint64_t elapsed = wall_ns() - t0;
+        window.latency.add(elapsed - std::min(elapsed, sim_ns));
+
+        run_app(*modem, state);
+
+        window.heap = std::min(window.heap, heap.bytes);
+        window.queue_max = std::max(window.queue_max, modem->queued());
+        window.queue_sum += modem->queued();
+        window.ticks += 1;
+
+        if(now != window_end)
+            continue;
+
+        window.allocs = heap.allocs;
+        heap.allocs = 0;
+        window.writes = writes;
+        writes = 0;
+
+        const bool warm = (now > kWarmup);
+        drifted |= report(hour, window, (have_baseline) ? &baseline : nullptr);
+
+        if(warm && !have_baseline) {
+            baseline = window;
+            have_baseline = true;
+        }
+
+        window = Window();
+        window_end += kWindow;
+        hour += 1;
+    }
+
+    const double seconds = (wall_ns() - start) / 1e9;
+    printf("%u simulated hours in %.0f s, echoed %llu bytes, %s\n",
+        hours, seconds, (unsigned long long) simulator.echoed(),
+        (drifted) ? "drift detected" : "no drift");
+
+    {
+        Inside inside;
+        delete modem;
+    }
+
+    return (drifted) ? 1 : 0;
+}
+
+/**
+ * @brief Debug print function.
+ *
+ * Only required when the library is compiled with -DNOVAGSM_DEBUG flag
+ *
+ * @param [in] level the log level of the message.
+ * @param [in] str message c-string
+ */
+void gsm_debug(int level, const char *str)
+{
+    if(level <= NOVAGSM_DEBUG_ERROR)
+        fprintf(stderr, "|%d| %4.2f h %s", level, now / 3600000.0, str);
+}
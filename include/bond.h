@@ -0,0 +1,240 @@
+/**
+ * @file bond.h
+ * @brief Stripes one stream across several modems.
+ * @author Wilkins White
+ * @copyright 2024 Nova Dynamics LLC
+ */
+
+#ifndef NOVAGSM_BOND_H_
+#define NOVAGSM_BOND_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "modem.h"
+
+namespace gsm {
+
+/** Maximum number of links in a bond. */
+constexpr size_t kBondLinks = 4;
+
+/** Number of out of order frames held for reassembly. */
+constexpr size_t kBondWindow = 8;
+
+/** Length of the frame header (bytes). */
+constexpr size_t kBondHeader = 6;
+
+/** Largest frame payload (bytes). */
+constexpr size_t kBondPayload = kSocketMax - kBondHeader;
+
+/** Interval between frames on a link benched for low goodput (ms). */
+constexpr uint32_t kBondProbe = 5000;
+
+/**
+ * @brief Function called with reassembled data.
+ *
+ * @param [in] data - in order payload.
+ * @param [in] size - length of data.
+ * @param [in] user - private data.
+ */
+typedef void (*bond_cb_t)(const uint8_t *data, size_t size, void *user);
+
+/**
+ * @brief Bonds the sockets of several modems into one stream.
+ *
+ * Outbound data is cut into frames that are sent on whichever link is
+ * free:
+ *
+ *     uint32 sequence (big endian)
+ *     uint16 length (big endian)
+ *     length bytes payload
+ *
+ * Free links pull the next frame, so each link carries data in proportion
+ * to its goodput, measured from the time each frame takes to be accepted.
+ * A link slower than 1/(kBondWindow - 1) of the others combined would hold
+ * a frame longer than the far end can buffer the frames behind it, so it
+ * is only given a frame every kBondProbe ms to refresh its measurement.
+ * A frame in flight on a link that drops is sent again on another link.
+ *
+ * Frames read from the links are reordered by sequence number and
+ * delivered in order to the receive callback. Duplicates are dropped. If a
+ * frame arrives more than kBondWindow frames ahead, the missing frames are
+ * skipped as lost.
+ *
+ * The far end must run the same framing, e.g. a server that accepts one
+ * connection per link.
+ */
+class Bond {
+public:
+    /**
+     * @brief Constructor.
+     *
+     * @param [in] millis - time source, see context_t::millis.
+     */
+    Bond(uint32_t (*millis)());
+
+    /**
+     * @brief Add a link.
+     *
+     * The link carries frames whenever its modem is connected.
+     *
+     * @param [in] modem - driver of the link.
+     * @return link index.
+     * @return -ENOSPC if kBondLinks links were already added.
+     */
+    int add(Modem &modem);
+
+    /**
+     * @brief Set a function to receive reassembled data.
+     *
+     * @param [in] func - function called with in order data.
+     * @param [in] user - private data to pass to the callback.
+     */
+    void set_receive_callback(bond_cb_t func, void *user = nullptr);
+
+    /**
+     * @brief Start sending data across the links.
+     *
+     * @param [in] data - buffer to write, must remain allocated until
+     * tx_busy() returns false.
+     * @param [in] size - number of bytes to write.
+     * @return -EINVAL if size is 0.
+     * @return -EBUSY if a send is already in progress.
+     * @return -ENOTCONN if no link is connected.
+     */
+    int send(const void *data, size_t size);
+
+    /** Cancel the send in progress. */
+    void stop_send();
+
+    /**
+     * @brief Move data between the bond and its links.
+     *
+     * Should be called after Modem::process() of every link.
+     */
+    void process();
+
+    /**
+     * @brief Returns true while a send is in progress.
+     *
+     * Frames from dropped links wait for a connected link, so this stays
+     * true until every frame is accepted or stop_send() is called.
+     */
+    inline bool tx_busy() const
+    {
+        return tx_buffer != nullptr;
+    }
+
+    /**
+     * @brief Returns the number of bytes acknowledged by the links.
+     */
+    inline size_t tx_count() const
+    {
+        return tx_done;
+    }
+
+    /**
+     * @brief Measured goodput of a link (bytes/s), or 0 if unknown.
+     *
+     * @param [in] link - link index.
+     */
+    uint32_t goodput(size_t link) const;
+
+private:
+    /** Frame sent on a link. */
+    struct Frame {
+        uint32_t seq; /**< Sequence number. */
+        size_t offset; /**< Position of the payload in tx_buffer. */
+        size_t size; /**< Payload length. */
+    };
+
+    /** State of a link. */
+    struct Link {
+        Modem *modem = nullptr; /**< Driver. */
+        bool busy = false; /**< A frame is in flight. */
+        Frame frame; /**< Frame in flight. */
+        uint32_t timer = 0; /**< Time the frame was queued. */
+        uint32_t goodput = 0; /**< Smoothed goodput (bytes/s). */
+        uint8_t tx[kSocketMax]; /**< Framed data being sent. */
+        uint8_t rx[kSocketMax]; /**< Data being received. */
+        uint8_t header[kBondHeader]; /**< Header being parsed. */
+        size_t header_count = 0; /**< Bytes of header parsed. */
+        uint8_t payload[kBondPayload]; /**< Payload being parsed. */
+        size_t payload_size = 0; /**< Payload length. */
+        size_t payload_count = 0; /**< Bytes of payload parsed. */
+    };
+
+    /** Reorder buffer entry. */
+    struct Slot {
+        bool full = false; /**< Holds a frame. */
+        uint16_t size = 0; /**< Payload length. */
+        uint8_t data[kBondPayload]; /**< Payload. */
+    };
+
+    /** Returns true if a link is fast enough to take a frame. */
+    bool eligible(const Link &link, uint32_t now) const;
+
+    /** Put the next frame on a link. */
+    void transmit(Link &link);
+
+    /** Check a link's frame in flight. */
+    void check(Link &link);
+
+    /** Read from a link. */
+    void receive(Link &link);
+
+    /** Parse data received on a link. */
+    void parse(Link &link, const uint8_t *data, size_t size);
+
+    /** Place a received frame in the reorder buffer. */
+    void accept(uint32_t seq, const uint8_t *data, size_t size);
+
+    /** Deliver in order frames to the receive callback. */
+    void deliver();
+
+    /** Time source. */
+    uint32_t (*millis)();
+
+    /** Links. */
+    Link links[kBondLinks];
+
+    /** Number of links. */
+    size_t link_count = 0;
+
+    /** Data being sent. */
+    const uint8_t *tx_buffer = nullptr;
+
+    /** Length of tx_buffer. */
+    size_t tx_size = 0;
+
+    /** Bytes of tx_buffer framed so far. */
+    size_t tx_index = 0;
+
+    /** Bytes of tx_buffer acknowledged. */
+    size_t tx_done = 0;
+
+    /** Next outbound sequence number. */
+    uint32_t tx_seq = 0;
+
+    /** Frames from dropped links waiting to be sent again. */
+    Frame retry[kBondLinks];
+
+    /** Number of frames in retry. */
+    size_t retry_count = 0;
+
+    /** Reorder buffer, indexed by sequence modulo kBondWindow. */
+    Slot window[kBondWindow];
+
+    /** Next inbound sequence number to deliver. */
+    uint32_t rx_seq = 0;
+
+    /** User receive callback. */
+    bond_cb_t receive_cb = nullptr;
+
+    /** Private data for receive_cb. */
+    void *receive_user = nullptr;
+};
+
+} // namespace gsm
+
+#endif // NOVAGSM_BOND_H_
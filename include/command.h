@@ -8,6 +8,7 @@
 #ifndef NOVAGSM_COMMAND_H_
 #define NOVAGSM_COMMAND_H_
 
+#include <cstddef>
 #include <cstdint>
 #include <vector>
 
@@ -16,6 +17,46 @@ namespace gsm {
 /** How long to wait for a command response. */
 constexpr uint32_t kDefaultTimeout = 1000;
 
+/**
+ * @brief Function called with each response line of a command.
+ *
+ * @param [in] data - response line, or null if the command timed out or
+ * was discarded.
+ * @param [in] size - length of the response line.
+ * @param [in] user - private data.
+ */
+typedef void (*response_cb_t)(const uint8_t *data, size_t size, void *user);
+
+/** Marks commands that belong to a driver subsystem. */
+enum class Tag : uint8_t {
+    none, /**< General command. */
+    filesystem, /**< Modem filesystem transfer. */
+    http, /**< Modem HTTP client. */
+    init, /**< Initialization sequence. */
+    pdp, /**< Application network. */
+    user, /**< Modem::command(), routed to the user. */
+    sync, /**< Discards late responses after an abandoned command. */
+};
+
+/**
+ * @brief Groups commands with similar response times.
+ *
+ * The driver learns the latency of each class and times out commands
+ * well before their worst case limit once it knows what to expect.
+ * Commands that change the modem or the network, e.g. AT+CIICR,
+ * AT+CIPSTART, AT+CIPSEND and its payload or AT+CIPRXGET=2, stay fixed:
+ * abandoning them early would leave the modem working on a command the
+ * driver gave up on.
+ */
+enum class Timing : uint8_t {
+    fixed, /**< Always wait for the full timeout. */
+    local, /**< Answered by the modem itself, e.g. AT+CIFSR. */
+    status, /**< Network status batch, e.g. AT+CSQ;+CREG?. */
+};
+
+/** Number of Timing classes. */
+constexpr size_t kTimingClasses = 3;
+
 /** Modem command object. */
 class Command
 {
@@ -59,6 +100,62 @@ public:
      */
     void append(const void *data, size_t size);
 
+    /**
+     * @brief Route the command's response lines to a function.
+     *
+     * @param [in] func - function to be called.
+     * @param [in] user - pointer to be passed when 'func' is called.
+     */
+    void set_response_callback(response_cb_t func, void *user = nullptr);
+
+    /**
+     * @brief Mark the command as belonging to a driver subsystem.
+     *
+     * @param [in] value - subsystem tag.
+     */
+    inline void set_tag(Tag value)
+    {
+        cmd_tag = value;
+    }
+
+    /**
+     * @brief Return the subsystem tag.
+     */
+    inline Tag tag() const
+    {
+        return cmd_tag;
+    }
+
+    /**
+     * @brief Set the latency class used to adapt the timeout.
+     *
+     * @param [in] value - latency class.
+     */
+    inline void set_timing(Timing value)
+    {
+        cmd_timing = value;
+    }
+
+    /**
+     * @brief Return the latency class.
+     */
+    inline Timing timing() const
+    {
+        return cmd_timing;
+    }
+
+    /**
+     * @brief Invoke the response callback.
+     *
+     * @param [in] data - response line.
+     * @param [in] size - length of the response line.
+     */
+    inline void respond(const uint8_t *data, size_t size) const
+    {
+        if (response_cb)
+            response_cb(data, size, response_cb_user);
+    }
+
     /**
      * @brief Return the data pointer.
      */
@@ -77,6 +174,8 @@ public:
 
     /**
      * @brief Return the command timeout in milliseconds.
+     *
+     * Upper limit when the timeout is adapted, see Timing.
      */
     inline uint32_t timeout() const
     {
@@ -86,6 +185,10 @@ public:
 private:
     uint32_t timeout_ms; /**< Response timeout (ms). */
     std::vector<uint8_t> payload; /**< Command payload. */
+    Tag cmd_tag = Tag::none; /**< Subsystem the command belongs to. */
+    Timing cmd_timing = Timing::fixed; /**< Latency class. */
+    response_cb_t response_cb = nullptr; /**< Response line callback. */
+    void *response_cb_user = nullptr; /**< Response callback private data. */
 };
 
 } // namespace gsm
@@ -0,0 +1,234 @@
+/**
+ * @file download.h
+ * @brief Streaming download with integrity verification.
+ * @author Wilkins White
+ * @copyright 2024 Nova Dynamics LLC
+ */
+
+#ifndef NOVAGSM_DOWNLOAD_H_
+#define NOVAGSM_DOWNLOAD_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "modem.h"
+#include "sha256.h"
+
+namespace gsm {
+
+/**
+ * @brief Function called to store a block of downloaded data.
+ *
+ * @param [in] offset - position of the block in the download.
+ * @param [in] data - block data.
+ * @param [in] size - length of the block.
+ * @param [in] user - private data.
+ * @return 0 on success or a negative error code to abort the download.
+ */
+typedef int (*sink_cb_t)(
+        size_t offset, const uint8_t *data, size_t size, void *user);
+
+/** Progress of a download that can be saved and resumed. */
+typedef struct {
+    size_t offset; /**< Number of bytes stored by the sink. */
+    Sha256 hash; /**< Hash of the first 'offset' bytes. */
+} checkpoint_t;
+
+/**
+ * @brief Streams a socket or HTTP download into a sink.
+ *
+ * Data is read into a fixed size block buffer, hashed and then passed to
+ * the sink, so that an image never has to be held in memory. The SHA-256
+ * of the stored data is compared to the expected digest once the last
+ * block is stored.
+ *
+ * The checkpoint only advances after a block is hashed and the sink
+ * accepts it. An interrupted download can be resumed by saving the
+ * checkpoint and passing it to start() again.
+ */
+class Download {
+public:
+    /**
+     * @brief Constructor.
+     *
+     * @param [in] modem - driver to download through.
+     * @param [in] block - buffer holding one block.
+     * @param [in] size - length of block, e.g. the flash page size.
+     */
+    Download(Modem &modem, uint8_t *block, size_t size);
+
+    /**
+     * @brief Set a function to store downloaded blocks.
+     *
+     * @param [in] func - function called with each block.
+     * @param [in] user - private data to pass to the callback.
+     */
+    void set_sink_callback(sink_cb_t func, void *user = nullptr);
+
+    /**
+     * @brief Set a function to be called when the download finishes.
+     *
+     * @param [in] func - function called with the result, see result().
+     * @param [in] user - private data to pass to the callback.
+     */
+    void set_complete_callback(
+            void (*func)(int result, void *user), void *user = nullptr);
+
+    /**
+     * @brief Start streaming data received from the socket.
+     *
+     * When resuming, the sender must be told to start from the checkpoint
+     * offset.
+     *
+     * @param [in] size - total length of the download.
+     * @param [in] digest - expected SHA-256 (kSha256Size bytes).
+     * @param [in] resume - checkpoint to resume from, or null.
+     * @return -EINVAL if inputs are invalid.
+     * @return -ENOTCONN if a connection is not established.
+     * @return -EALREADY if a download is already in progress.
+     */
+    int start(
+            size_t size,
+            const uint8_t *digest,
+            const checkpoint_t *resume = nullptr);
+
+    /**
+     * @brief Start streaming a resource from the HTTP client.
+     *
+     * The client must be connected with Modem::http_open(). When resuming,
+     * the resource is requested starting at the checkpoint offset.
+     *
+     * @param [in] path - resource path, e.g. "/firmware.bin". Must remain
+     * allocated until the download finishes.
+     * @param [in] size - total length of the download.
+     * @param [in] digest - expected SHA-256 (kSha256Size bytes).
+     * @param [in] resume - checkpoint to resume from, or null.
+     * @return -EINVAL if inputs are invalid.
+     * @return -ENOTCONN if the client is not connected.
+     * @return -EALREADY if a download is already in progress.
+     */
+    int start(
+            const char *path,
+            size_t size,
+            const uint8_t *digest,
+            const checkpoint_t *resume = nullptr);
+
+    /**
+     * @brief Abort the download, keeping the checkpoint.
+     *
+     * @warning an HTTP read in progress still completes into the block
+     * buffer, see Modem::http_busy().
+     */
+    void stop();
+
+    /**
+     * @brief Advance the download.
+     *
+     * Should be called after Modem::process().
+     */
+    void process();
+
+    /**
+     * @brief Returns true if a download is in progress.
+     */
+    inline bool busy() const
+    {
+        return step != Step::idle;
+    }
+
+    /**
+     * @brief Result of the last download.
+     *
+     * @return 0 if the data was stored and verified.
+     * @return -EBADMSG if the digest did not match.
+     * @return -ECONNRESET if the transfer was interrupted.
+     * @return -ECANCELED if the download was stopped.
+     * @return an error code returned by the sink.
+     */
+    inline int result() const
+    {
+        return status;
+    }
+
+    /**
+     * @brief Returns the last verified position of the download.
+     */
+    inline const checkpoint_t &checkpoint() const
+    {
+        return point;
+    }
+
+private:
+    /** Download steps. */
+    enum class Step {
+        idle,
+        socket,
+        http,
+    };
+
+    /** Validate the inputs and request the first block. */
+    int begin(
+            Step source,
+            const char *path,
+            size_t size,
+            const uint8_t *digest,
+            const checkpoint_t *resume);
+
+    /** Request the next block. */
+    int request();
+
+    /** Store the block and advance the checkpoint. */
+    int commit();
+
+    /** Compare the hash of the stored data to the expected digest. */
+    void verify();
+
+    /** Finish the download and notify the user. */
+    void finish(int result);
+
+    /** Driver. */
+    Modem &modem;
+
+    /** Block buffer. */
+    uint8_t *block_buffer;
+
+    /** Length of the block buffer. */
+    size_t block_size;
+
+    /** Length of the current read. */
+    size_t pending = 0;
+
+    /** Current step. */
+    Step step = Step::idle;
+
+    /** Result of the last download. */
+    int status = 0;
+
+    /** Total length of the download. */
+    size_t total = 0;
+
+    /** HTTP resource path. */
+    const char *http_path = nullptr;
+
+    /** Expected digest. */
+    uint8_t expected[kSha256Size];
+
+    /** Last verified position. */
+    checkpoint_t point;
+
+    /** User sink callback. */
+    sink_cb_t sink_cb = nullptr;
+
+    /** Private data for sink_cb. */
+    void *sink_user = nullptr;
+
+    /** User completion callback. */
+    void (*complete_cb)(int result, void *user) = nullptr;
+
+    /** Private data for complete_cb. */
+    void *complete_user = nullptr;
+};
+
+} // namespace gsm
+
+#endif // NOVAGSM_DOWNLOAD_H_
@@ -0,0 +1,194 @@
+/**
+ * @file failover.h
+ * @brief Hot-standby failover between two modems.
+ * @author Wilkins White
+ * @copyright 2024 Nova Dynamics LLC
+ */
+
+#ifndef NOVAGSM_FAILOVER_H_
+#define NOVAGSM_FAILOVER_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "modem.h"
+
+namespace gsm {
+
+/** Interval between bring-up attempts on a modem (ms). */
+constexpr uint32_t kFailoverRetry = 5000;
+
+/** Default time the signal must stay poor before switching (ms). */
+constexpr uint32_t kFailoverHold = 10000;
+
+/**
+ * @brief Keeps a second modem online to take over from the first.
+ *
+ * Both modems are brought up and held up: configured, registered, with the
+ * data connection active and, if a host is given, a socket open. Traffic
+ * goes through active() while standby() waits.
+ *
+ * The roles swap as soon as the standby is up and the active modem is not,
+ * which covers 'CLOSED', '+PDP: DEACT' and watchdog resets since each
+ * drops the modem out of State::open / State::online. They also swap when
+ * the active modem's signal stays below the threshold for the hold time
+ * while the standby's does not. The failed modem is then brought back up
+ * as the new standby.
+ *
+ * A switch only changes which modem the application should use. Data in
+ * flight on the failed modem is not moved, see set_switch_callback().
+ */
+class Failover {
+public:
+    /**
+     * @brief Constructor.
+     *
+     * @param [in] primary - modem that starts as active.
+     * @param [in] secondary - modem that starts as standby.
+     * @param [in] millis - time source, see context_t::millis.
+     */
+    Failover(Modem &primary, Modem &secondary, uint32_t (*millis)());
+
+    /**
+     * @brief Start bringing both modems up.
+     *
+     * @param [in] apn - access point name, must remain allocated.
+     * @param [in] host - server to keep a socket open to, or null to stop
+     * at State::online. Must remain allocated.
+     * @param [in] port - server port.
+     * @return -EINVAL if apn is null.
+     */
+    int start(const char *apn, const char *host = nullptr,
+            unsigned int port = 0);
+
+    /** Stop managing the modems, leaving them in their current state. */
+    void stop();
+
+    /**
+     * @brief Set the signal quality below which to switch.
+     *
+     * @param [in] csq - minimum [AT+CSQ] RSSI (0-31), or 0 to ignore.
+     * @param [in] rsrp - minimum RSRP (dBm), only checked on LTE cells.
+     * @param [in] hold - time the signal must stay poor (ms).
+     */
+    void set_signal_threshold(
+            uint8_t csq, int16_t rsrp = -140, uint32_t hold = kFailoverHold);
+
+    /**
+     * @brief Set a function to be called when the roles swap.
+     *
+     * @param [in] func - function called with the new active modem and
+     * the modem it replaced.
+     * @param [in] user - pointer to be passed when 'func' is called.
+     */
+    void set_switch_callback(
+            void (*func)(Modem &active, Modem &previous, void *user),
+            void *user = nullptr);
+
+    /**
+     * @brief Bring the modems up and check the active one.
+     *
+     * Should be called after Modem::process() of both modems.
+     */
+    void process();
+
+    /**
+     * @brief Returns the modem that should carry traffic.
+     */
+    inline Modem &active() const
+    {
+        return *modems[active_index];
+    }
+
+    /**
+     * @brief Returns the modem held in reserve.
+     */
+    inline Modem &standby() const
+    {
+        return *modems[active_index ^ 1];
+    }
+
+    /**
+     * @brief Returns true if the standby can take over immediately.
+     */
+    inline bool standby_ready() const
+    {
+        return ready(standby());
+    }
+
+    /**
+     * @brief Number of times the roles have swapped.
+     */
+    inline uint32_t switches() const
+    {
+        return switch_count;
+    }
+
+private:
+    /** Returns true if a modem is fully up. */
+    bool ready(const Modem &modem) const;
+
+    /** Returns true if a modem's signal is below the threshold. */
+    bool poor(const Modem &modem) const;
+
+    /** Move a modem one step toward ready. */
+    void bring_up(size_t index, uint32_t now);
+
+    /** Swap the roles. */
+    void swap(const char *reason);
+
+    /** Time source. */
+    uint32_t (*millis)();
+
+    /** Managed modems. */
+    Modem *modems[2];
+
+    /** Index of the active modem. */
+    size_t active_index = 0;
+
+    /** Time of the next bring-up attempt on each modem. */
+    uint32_t retry_timer[2] = {};
+
+    /** State of each modem at the last bring-up check. */
+    State last_state[2] = { State::reset, State::reset };
+
+    /** True while start() is in effect. */
+    bool running = false;
+
+    /** Access point name. */
+    const char *apn = nullptr;
+
+    /** Server to hold a socket open to, or null. */
+    const char *host = nullptr;
+
+    /** Server port. */
+    unsigned int port = 0;
+
+    /** Minimum RSSI, or 0 to ignore. */
+    uint8_t min_csq = 0;
+
+    /** Minimum RSRP (dBm). */
+    int16_t min_rsrp = -140;
+
+    /** Time the signal must stay poor (ms). */
+    uint32_t signal_hold = kFailoverHold;
+
+    /** True while the active modem's signal is poor. */
+    bool signal_poor = false;
+
+    /** Time the active modem's signal became poor. */
+    uint32_t signal_timer = 0;
+
+    /** Number of role swaps. */
+    uint32_t switch_count = 0;
+
+    /** User switch callback. */
+    void (*switch_cb)(Modem &active, Modem &previous, void *user) = nullptr;
+
+    /** Private data for switch_cb. */
+    void *switch_user = nullptr;
+};
+
+} // namespace gsm
+
+#endif // NOVAGSM_FAILOVER_H_
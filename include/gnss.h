@@ -0,0 +1,61 @@
+/**
+ * @file gnss.h
+ * @brief GNSS navigation information parser.
+ * @author Wilkins White
+ * @copyright 2024 Nova Dynamics LLC
+ */
+
+#ifndef NOVAGSM_GNSS_H_
+#define NOVAGSM_GNSS_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace gsm {
+
+/**
+ * @brief GNSS navigation information reported by AT+CGNSINF.
+ *
+ * Values are stored as fixed point integers so that no floating point
+ * support is required to parse them. Fields the modem leaves empty are 0.
+ */
+typedef struct {
+    uint8_t run;        /**< GNSS engine is powered on. */
+    uint8_t fix;        /**< Position fix is valid. */
+    uint8_t month;      /**< UTC month (1-12). */
+    uint8_t day;        /**< UTC day of the month (1-31). */
+    uint8_t hour;       /**< UTC hour (0-23). */
+    uint8_t minute;     /**< UTC minute (0-59). */
+    uint8_t second;     /**< UTC second (0-59). */
+    uint8_t mode;       /**< Fix mode. */
+    uint16_t year;      /**< UTC year. */
+    uint16_t millis;    /**< UTC milliseconds (0-999). */
+    int32_t latitude;   /**< Latitude (degrees * 1e6). */
+    int32_t longitude;  /**< Longitude (degrees * 1e6). */
+    int32_t altitude;   /**< MSL altitude (m * 10). */
+    uint16_t speed;     /**< Speed over ground (km/h * 100). */
+    uint16_t course;    /**< Course over ground (degrees * 100). */
+    uint16_t hdop;      /**< Horizontal dilution of precision (* 100). */
+    uint16_t pdop;      /**< Position dilution of precision (* 100). */
+    uint16_t vdop;      /**< Vertical dilution of precision (* 100). */
+    uint8_t gps_view;   /**< GPS satellites in view. */
+    uint8_t gnss_used;  /**< GNSS satellites used in the fix. */
+    uint8_t glonass_view; /**< GLONASS satellites in view. */
+    uint8_t cn0;        /**< Maximum C/N0 (dBHz). */
+} gnss_t;
+
+/**
+ * @brief Parse the fields of a +CGNSINF or +UGNSINF response.
+ *
+ * The line is parsed in place without copying or allocating.
+ *
+ * @param [in] data - response data following the "+CGNSINF: " prefix.
+ * @param [in] size - length of data.
+ * @param [out] fix - parsed navigation information.
+ * @return -EINVAL if the response is malformed.
+ */
+int parse_gnss(const uint8_t *data, size_t size, gnss_t *fix);
+
+} // namespace gsm
+
+#endif // NOVAGSM_GNSS_H_
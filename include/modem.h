@@ -12,6 +12,7 @@
 #include <queue>
 
 #include "command.h"
+#include "gnss.h"
 #include "parser.h"
 
 /** Handles buffered communication through a GSM/GPRS modem. */
@@ -59,6 +60,42 @@ typedef struct {
      * @brief Returns number of milliseconds elapsed since program start.
      */
     uint32_t (*millis)();
+
+    /**
+     * @brief Toggle the modem's reset line or cycle its power (optional).
+     *
+     * Called by the watchdog when resetting with AT+CFUN=1,1 fails to
+     * recover an unresponsive modem. May be null.
+     */
+    void (*hard_reset)();
+
+    /**
+     * @brief Change the host's baud rate (optional).
+     *
+     * Enables baud rate detection. While waiting for the modem to respond
+     * the driver cycles through common rates with short probes and keeps
+     * the first rate the modem answers. May be null.
+     *
+     * @param [in] baud - new baud rate.
+     */
+    void (*set_baud)(uint32_t baud);
+
+    /**
+     * @brief Host baud rate (optional).
+     *
+     * The modem is fixed to this rate with AT+IPR when initialized, so it
+     * reports 'RDY' after a reset instead of waiting to detect the rate.
+     * A rate found through set_baud takes precedence. May be 0 to leave
+     * the modem's rate alone.
+     */
+    uint32_t baud;
+
+    /**
+     * @brief True if the host uses RTS/CTS flow control.
+     *
+     * Applied to the modem with AT+IFC when initialized.
+     */
+    bool flow;
 } context_t;
 
 /**
@@ -91,8 +128,51 @@ enum class Event {
     new_data, /**< New data available for read(). */
     rx_complete, /**< A read command has finished. */
     tx_complete, /**< A write command has finished. */
+    watchdog, /**< The watchdog reset an unresponsive modem. */
+    recovered, /**< The modem is ready again after a watchdog reset. */
+    fs_complete, /**< A file transfer has finished. */
+    fs_error, /**< An error occurred during a file transfer. */
+    http_connected, /**< The HTTP client is connected to the server. */
+    http_complete, /**< An HTTP download has finished. */
+    http_error, /**< An error occurred in the HTTP client. */
+    pdp_active, /**< The application network was activated. */
+    pdp_inactive, /**< The application network was deactivated. */
+    pdp_error, /**< The application network failed to activate. */
+};
+
+/**
+ * @brief Modem filesystem directories.
+ * @see fs_write().
+ */
+enum class Directory {
+    custapp, /**< 0x0 - /custapp/ */
+    fota, /**< 0x1 - /fota/ */
+    datatx, /**< 0x2 - /datatx/ */
+    customer, /**< 0x3 - /customer/ */
+};
+
+/**
+ * @brief Send priorities.
+ * @see send().
+ */
+enum class Priority {
+    urgent, /**< Send as soon as the modem has buffer space. */
+    bulk, /**< Defer while the link quality is poor. */
 };
 
+/**
+ * @brief Serving cell information reported by AT+CPSI?
+ *
+ * Signal metrics are only reported while camped on an LTE cell.
+ */
+typedef struct {
+    bool lte;       /**< Serving cell is LTE (CAT-M1 or NB-IoT). */
+    int16_t rsrq;   /**< Reference signal received quality (dB). */
+    int16_t rsrp;   /**< Reference signal received power (dBm). */
+    int16_t rssi;   /**< Received signal strength indicator (dBm). */
+    int16_t sinr;   /**< Signal to interference plus noise ratio (dB). */
+} cpsi_t;
+
 /** Class representing the connection with a GSM/GPRS modem. */
 class Modem {
 public:
@@ -133,6 +213,15 @@ public:
     void set_error_callback(
             void (*func)(int error, void *user), void *user = nullptr);
 
+    /**
+     * @brief Set a function to be called on a new GNSS fix.
+     *
+     * @param [in] func - function to be called.
+     * @param [in] user - pointer to be passed when 'func' is called.
+     */
+    void set_gnss_callback(
+            void (*func)(const gnss_t *fix, void *user), void *user = nullptr);
+
     /**
      * @brief Handle communication with the modem.
      *
@@ -153,6 +242,8 @@ public:
      *
      * Must be in State::ready, transitions to State::registered.
      *
+     * Limits the periodic registration queries to those relevant to 'mode'.
+     *
      * @param [in] apn - access point name.
      * @param [in] mode - CNMP mode (default LTE)
      * @return -EINVAL if 'apn' is null or larger than 63 bytes.
@@ -173,6 +264,8 @@ public:
      * @return -ENETUNREACH if the network is not available.
      * @return -EALREADY if authentication is already in progress.
      * @return -EBUSY if the socket is open.
+     * @return -EAGAIN if the socket settings have not been applied yet.
+     * @return -EIO if the modem rejected the socket settings.
      */
     int authenticate(
             const char *apn,
@@ -231,11 +324,66 @@ public:
      * Asynchronously sends data to the modem. The buffer pointed to by 'data'
      * must remain allocated until the send is complete.
      *
+     * Bulk sends are held while the link quality is below the threshold set
+     * by set_bulk_threshold(), see tx_deferred().
+     *
      * @param [in] data - buffer to write.
      * @param [in] size - number of bytes to write.
+     * @param [in] priority - scheduling priority.
      * @return -ENOTCONN if a connection is not established.
      */
-    int send(const void *data, size_t size);
+    int send(
+            const void *data,
+            size_t size,
+            Priority priority = Priority::urgent);
+
+    /**
+     * @brief Set the link quality required to send bulk data.
+     *
+     * Compared against the metrics reported by [AT+CPSI?]. Bulk sends are
+     * not deferred while the serving cell reports no LTE metrics.
+     *
+     * @param [in] rsrp - minimum RSRP (dBm).
+     * @param [in] sinr - minimum SINR (dB).
+     * @param [in] max_defer - longest time to hold a bulk send (ms), or 0
+     * to wait indefinitely.
+     */
+    void set_bulk_threshold(
+            int16_t rsrp,
+            int16_t sinr,
+            uint32_t max_defer = 300000);
+
+    /**
+     * @brief Set how the socket is shared between receiving and sending.
+     *
+     * While both a receive() and a send() have data waiting, reads and
+     * writes are interleaved so that each direction moves bytes in
+     * proportion to its share. The default of 1:1 alternates equally.
+     *
+     * @param [in] rx - receive share.
+     * @param [in] tx - send share.
+     * @return -EINVAL if a share is 0.
+     */
+    int set_duplex_share(uint8_t rx, uint8_t tx);
+
+    /**
+     * @brief Enable timeouts learned from command latency.
+     *
+     * Each Timing class keeps a smoothed latency and deviation. Once a few
+     * responses have been seen, its commands time out after the mean plus
+     * four deviations instead of the worst case limit. Each timeout
+     * doubles the class's wait until the next response. Commands with side
+     * effects, e.g. connect() or send(), always wait for the full limit.
+     *
+     * A command abandoned early may still be answered, so the driver then
+     * sends AT+CMEE? and discards final result codes until its answer
+     * arrives. Nothing else is sent meanwhile. The early timeout and each
+     * unanswered AT+CMEE? period count towards the watchdog but do not
+     * change the driver state. Enabled by default.
+     *
+     * @param [in] enable - false to always wait for the full limit.
+     */
+    void set_adaptive_timeouts(bool enable);
 
     /**
      * @brief Cancel an ongoing send() call.
@@ -245,6 +393,184 @@ public:
      */
     void stop_send();
 
+    /**
+     * @brief Start writing a file to the modem's filesystem.
+     *
+     * Asynchronously writes 'size' bytes with AT+CFSWFILE in chunks as large
+     * as the buffer allows. The buffer pointed to by 'data' must remain
+     * allocated until Event::fs_complete or Event::fs_error.
+     *
+     * @param [in] dir - directory to write in.
+     * @param [in] name - file name.
+     * @param [in] data - buffer to write.
+     * @param [in] size - number of bytes to write.
+     * @param [in] append - append to the file instead of replacing it.
+     * @return -EINVAL if inputs are null.
+     * @return -ENAMETOOLONG if 'name' is too long.
+     * @return -ENODEV if the device is not responsive.
+     * @return -EALREADY if a file transfer is already in progress.
+     */
+    int fs_write(
+            Directory dir,
+            const char *name,
+            const void *data,
+            size_t size,
+            bool append = false);
+
+    /**
+     * @brief Start reading a file from the modem's filesystem.
+     *
+     * Asynchronously reads up to 'size' bytes with AT+CFSRFILE in chunks as
+     * large as the buffer allows. Reading stops early at the end of the
+     * file, see fs_count().
+     *
+     * @param [in] dir - directory to read from.
+     * @param [in] name - file name.
+     * @param [out] data - buffer to read into.
+     * @param [in] size - number of bytes to read.
+     * @param [in] offset - position in the file to start reading from.
+     * @return -EINVAL if inputs are null.
+     * @return -ENAMETOOLONG if 'name' is too long.
+     * @return -ENODEV if the device is not responsive.
+     * @return -EALREADY if a file transfer is already in progress.
+     */
+    int fs_read(
+            Directory dir,
+            const char *name,
+            void *data,
+            size_t size,
+            size_t offset = 0);
+
+    /**
+     * @brief Connect the modem's HTTP(S) client to a server.
+     *
+     * TCP, TLS and HTTP are handled by the modem (AT+SHCONN). The app network
+     * must be active (AT+CNACT). Signals Event::http_connected on success.
+     *
+     * An https server is verified against 'ca', a PEM root certificate
+     * written to Directory::customer with fs_write() beforehand.
+     *
+     * @param [in] url - server url, e.g. "https://example.com".
+     * @param [in] ca - root certificate file name, for https.
+     * @param [in] insecure - allow https without a certificate, skipping
+     * server verification.
+     * @return -EINVAL if 'url' is null or too long.
+     * @return -EINVAL if an https url has no 'ca' and 'insecure' is false.
+     * @return -ENODEV if the device is not responsive.
+     * @return -ENETUNREACH if the network is not available.
+     * @return -EALREADY if the client is already connected.
+     */
+    int http_open(
+            const char *url,
+            const char *ca = nullptr,
+            bool insecure = false);
+
+    /**
+     * @brief Start downloading a resource.
+     *
+     * Asynchronously requests 'size' bytes starting at 'offset' with ranged
+     * GET requests (AT+SHREQ) and reads the body into 'data' with AT+SHREAD
+     * in chunks as large as the buffer allows. Signals Event::http_complete
+     * when 'size' bytes were read or the resource ended, see http_count().
+     *
+     * After an error the download can be resumed by calling http_get()
+     * again with 'offset' advanced by http_count().
+     *
+     * @param [in] path - resource path, e.g. "/firmware.bin".
+     * @param [out] data - buffer to read into.
+     * @param [in] size - number of bytes to read.
+     * @param [in] offset - position in the resource to start reading from.
+     * @return -EINVAL if inputs are null or 'path' is too long.
+     * @return -ENOTCONN if the client is not connected.
+     * @return -EALREADY if a download is already in progress.
+     */
+    int http_get(
+            const char *path,
+            void *data,
+            size_t size,
+            size_t offset = 0);
+
+    /**
+     * @brief Disconnect the HTTP client (AT+SHDISC).
+     *
+     * @return -ENOTCONN if the client is not connected.
+     */
+    int http_close();
+
+    /**
+     * @brief Activate the application network (AT+CNACT).
+     *
+     * The SIM7000 has a single application network, used by the modem's
+     * own clients such as http_open(). It is separate from the data
+     * connection of authenticate(), which carries the socket. Signals
+     * Event::pdp_active or Event::pdp_error.
+     *
+     * @param [in] apn - access point name.
+     * @return -EINVAL if 'apn' is null or too long.
+     * @return -ENODEV if the device is not responsive.
+     * @return -ENETUNREACH if the network is not available.
+     * @return -EALREADY if the network is already active.
+     */
+    int pdp_activate(const char *apn);
+
+    /**
+     * @brief Deactivate the application network.
+     *
+     * Signals Event::pdp_inactive.
+     *
+     * @return -ENOTCONN if the network is not active.
+     */
+    int pdp_deactivate();
+
+    /**
+     * @brief Power on the GNSS engine and start reporting fixes.
+     *
+     * Fixes are read with AT+CGNSINF as part of the driver's regular polls
+     * so they never delay socket traffic. If 'urc' is true the modem reports
+     * fixes itself (AT+CGNSURC) and no polling is done.
+     *
+     * A modem reset powers off the GNSS engine.
+     *
+     * @param [in] interval - time between fixes (ms).
+     * @param [in] urc - use unsolicited reports instead of polling.
+     * @return -ENODEV if the device is not responsive.
+     */
+    int gnss_start(uint32_t interval = 1000, bool urc = false);
+
+    /**
+     * @brief Power off the GNSS engine.
+     *
+     * @return -ENODEV if the device is not responsive.
+     */
+    int gnss_stop();
+
+    /**
+     * @brief Queue an arbitrary AT command.
+     *
+     * The command is scheduled alongside the driver's own commands. While it
+     * is pending every response line is passed to 'func', ending with the
+     * final 'OK', 'ERROR' or '+CME ERROR' line. If the command times out or
+     * is discarded by reset() 'func' is called once with null data. Without
+     * 'func' the response is discarded. A timeout does not change the
+     * driver state.
+     *
+     * Socket commands (AT+CIP...) must not be sent this way while a
+     * connection is open.
+     *
+     * @param [in] data - command without the leading 'AT', e.g. "+CCID".
+     * @param [in] func - function to receive the response lines.
+     * @param [in] user - pointer to be passed when 'func' is called.
+     * @param [in] timeout - maximum time to wait for a response (ms).
+     * @return -EINVAL if 'data' is null.
+     * @return -ENODEV if the device is not responsive.
+     * @return -EMSGSIZE if 'data' is larger than the buffer.
+     */
+    int command(
+            const char *data,
+            response_cb_t func = nullptr,
+            void *user = nullptr,
+            uint32_t timeout = kDefaultTimeout);
+
     /**
      * @brief The number of bytes available to receive().
      */
@@ -284,6 +610,25 @@ public:
         return connected() && tx_buffer && tx_index < tx_size;
     }
 
+    /**
+     * @brief Current AT+CIPSEND chunk size (bytes).
+     *
+     * Adapted per connection: grows toward kSocketMax while sends succeed
+     * and shrinks on 'SEND FAIL' or timeouts.
+     */
+    inline size_t tx_chunk() const
+    {
+        return chunk_size;
+    }
+
+    /**
+     * @brief Returns true if a bulk send is held for better link quality.
+     */
+    inline bool tx_deferred() const
+    {
+        return tx_busy() && tx_hold;
+    }
+
     /**
      * @brief Poll the status of the last receive() call
      *
@@ -304,6 +649,63 @@ public:
         return (tx_buffer) ? tx_index : 0;
     }
 
+    /**
+     * @brief Poll the status of the last fs_write() or fs_read() call.
+     *
+     * @return true if the transfer is in progress.
+     */
+    inline bool fs_busy() const
+    {
+        return fs_step != FsStep::idle;
+    }
+
+    /**
+     * @brief Poll the status of the last fs_write() or fs_read() call.
+     *
+     * @return number of bytes transferred.
+     */
+    inline size_t fs_count() const
+    {
+        return fs_index;
+    }
+
+    /**
+     * @brief Returns true if the HTTP client is connected.
+     */
+    inline bool http_connected() const
+    {
+        return http_step == HttpStep::connected || http_busy();
+    }
+
+    /**
+     * @brief Poll the status of the last http_get() call.
+     *
+     * @return true if the download is in progress.
+     */
+    inline bool http_busy() const
+    {
+        return http_step == HttpStep::requesting
+            || http_step == HttpStep::reading;
+    }
+
+    /**
+     * @brief Poll the status of the last http_get() call.
+     *
+     * @return number of bytes downloaded.
+     */
+    inline size_t http_count() const
+    {
+        return http_index;
+    }
+
+    /**
+     * @brief Returns the HTTP status code of the last response.
+     */
+    inline uint16_t http_status() const
+    {
+        return http_code;
+    }
+
     /**
      * @brief Return the device state.
      */
@@ -408,7 +810,127 @@ public:
         return modem_cifsr;
     }
 
+    /**
+     * @brief Returns the serving cell information reported by [AT+CPSI?]
+     */
+    inline const cpsi_t &cpsi() const
+    {
+        return modem_cpsi;
+    }
+
+    /**
+     * @brief Returns true if the application network is active.
+     */
+    inline bool pdp_active() const
+    {
+        return pdp_step == PdpStep::active;
+    }
+
+    /**
+     * @brief Returns the IP address of the application network.
+     *
+     * @return the address reported by [AT+CNACT?], or "" if unknown.
+     */
+    inline const char *pdp_address() const
+    {
+        return pdp_ip;
+    }
+
+    /**
+     * @brief Returns the last fix reported by [AT+CGNSINF].
+     */
+    inline const gnss_t &gnss() const
+    {
+        return modem_gnss;
+    }
+
+    /**
+     * @brief Time taken by the last watchdog recovery (ms).
+     *
+     * Measured from the first watchdog reset until the modem was ready to
+     * accept commands again.
+     */
+    inline uint32_t recovery_time() const
+    {
+        return recovery_ms;
+    }
+
+    /**
+     * @brief Learned timeout of a command class (ms).
+     *
+     * @param [in] timing - command class.
+     * @return timeout before the limit is applied, or 0 if not learned.
+     */
+    uint32_t learned_timeout(Timing timing) const;
+
+    /**
+     * @brief Total number of bytes read from the socket.
+     */
+    inline uint64_t rx_total() const
+    {
+        return rx_total_count;
+    }
+
+    /**
+     * @brief Total number of bytes sent through the socket.
+     */
+    inline uint64_t tx_total() const
+    {
+        return tx_total_count;
+    }
+
+    /**
+     * @brief Returns the last +CME ERROR code, or 0 if none was reported.
+     */
+    inline int last_error() const
+    {
+        return cme_error;
+    }
+
+    /**
+     * @brief Number of bytes discarded by the parser as line noise.
+     */
+    inline size_t discarded() const
+    {
+        return parser.discarded();
+    }
+
+    /**
+     * @brief Number of commands waiting to be sent.
+     */
+    inline size_t queued() const
+    {
+        return cmd_buffer.size();
+    }
+
 private:
+    /** Application network steps. */
+    enum class PdpStep : uint8_t {
+        inactive,
+        activating,
+        active,
+        deactivating,
+    };
+
+    /** Modem filesystem transfer steps. */
+    enum class FsStep : uint8_t {
+        idle, /**< No transfer. */
+        init, /**< Waiting for AT+CFSINIT. */
+        write, /**< Writing with AT+CFSWFILE. */
+        read, /**< Reading with AT+CFSRFILE. */
+        term, /**< Waiting for AT+CFSTERM. */
+    };
+
+    /** Modem HTTP client steps. */
+    enum class HttpStep : uint8_t {
+        idle, /**< Not connected. */
+        connecting, /**< Waiting for AT+SHCONN. */
+        connected, /**< Connected, no download in progress. */
+        requesting, /**< Waiting for the +SHREQ response. */
+        reading, /**< Reading the body with AT+SHREAD. */
+        closing, /**< Waiting for AT+SHDISC. */
+    };
+
     /**
      * @brief Process a completed packet.
      *
@@ -424,8 +946,40 @@ private:
      */
     void set_state(State state);
 
-    /** Free the pending command. */
-    void free_pending();
+    /**
+     * @brief Free the pending command.
+     *
+     * @param [in] answered - false if the modem did not respond, so the
+     * latency is not sampled.
+     */
+    void free_pending(bool answered = true);
+
+    /** Returns the timeout for the pending command (ms). */
+    uint32_t pending_timeout() const;
+
+    /** Update the latency estimate of the pending command's class. */
+    void sample_latency();
+
+    /** Free all queued commands. */
+    void clear_commands();
+
+    /** Reset cached values and socket state after a modem reset. */
+    void reset_device();
+
+    /**
+     * @brief Reset an unresponsive modem.
+     *
+     * Tries AT+CFUN=1,1 first and escalates to context_t::hard_reset if the
+     * modem still does not recover.
+     */
+    void trip_watchdog();
+
+    /**
+     * @brief Send a command immediately, bypassing the queue.
+     *
+     * @param [in] cmd - Command object, becomes the pending command.
+     */
+    void send_command(Command *cmd);
 
     /**
      * @brief Add a command to the end of the queue.
@@ -459,9 +1013,138 @@ private:
      */
     int socket_send(const uint8_t *data, size_t count);
 
+    /**
+     * @brief Adapt the chunk size to the result of a send.
+     *
+     * @param [in] ok - true for 'SEND OK'.
+     */
+    void adapt_chunk(bool ok);
+
     /** Handle a command timeout. */
     void handle_timeout();
 
+    /** Count a timeout towards the watchdog. */
+    void count_timeout();
+
+    /** Send AT+CMEE? to find the end of an abandoned command's response. */
+    void resync();
+
+    /** Handle responses while resynchronizing. */
+    bool parse_sync(uint8_t *start, size_t size);
+
+    /**
+     * @brief Check if a GNSS poll should be added to the next batch.
+     *
+     * @return true if the poll interval has elapsed.
+     */
+    bool gnss_due();
+
+    /** Handle a GNSS fix. */
+    void parse_gnss_fix(uint8_t *start, size_t size);
+
+    /**
+     * @brief Check if the registration status should be polled.
+     *
+     * @return true if the poll interval has elapsed.
+     */
+    bool registration_due();
+
+    /** Returns true while searching for the modem's baud rate. */
+    inline bool autobaud() const
+    {
+        return ctx.set_baud != nullptr && !baud_locked;
+    }
+
+    /** Switch the host to the next candidate baud rate. */
+    void next_baud();
+
+    /** Queue the initialization steps that have not been applied. */
+    int push_init();
+
+    /** Handle an unsolicited registration report. */
+    void handle_registration();
+
+    /**
+     * @brief Check if a serving cell poll should be added to the next batch.
+     *
+     * @return true if the poll interval has elapsed.
+     */
+    bool cpsi_due();
+
+    /** Handle a serving cell report. */
+    void parse_cpsi(uint8_t *start, size_t size);
+
+    /**
+     * @brief Check if the pending send may use the link.
+     *
+     * @return false while a bulk send is deferred.
+     */
+    bool tx_ready();
+
+    /**
+     * @brief Start a modem filesystem transfer.
+     *
+     * @param [in] step - FsStep::write or FsStep::read.
+     * @param [in] dir - directory.
+     * @param [in] name - file name.
+     */
+    int fs_start(FsStep step, Directory dir, const char *name);
+
+    /** Queue the next chunk of the file transfer. */
+    int fs_next();
+
+    /**
+     * @brief End the file transfer.
+     *
+     * The result is reported once AT+CFSTERM returns, so a new transfer
+     * can be started from the event callback.
+     *
+     * @param [in] event - Event::fs_complete or Event::fs_error.
+     */
+    void fs_finish(Event event);
+
+    /** Return to FsStep::idle and report the transfer result. */
+    void fs_done();
+
+    /** Handle file transfer responses. */
+    bool parse_file(uint8_t *start, size_t size);
+
+    /**
+     * @brief Queue an HTTP client command.
+     *
+     * @param [in] cmd - Command object.
+     */
+    int push_http(Command *cmd);
+
+    /** Request the next range of the download. */
+    int http_request();
+
+    /** Read the next chunk of the response body. */
+    int http_next();
+
+    /**
+     * @brief End the download.
+     *
+     * @param [in] event - Event::http_complete or Event::http_error.
+     */
+    void http_finish(Event event);
+
+    /** Handle HTTP client responses. */
+    bool parse_http(uint8_t *start, size_t size);
+
+    /**
+     * @brief Mark the application network inactive.
+     *
+     * @param [in] event - event to signal.
+     */
+    void pdp_finish(Event event);
+
+    /** Handle application network command responses. */
+    bool parse_pdp(uint8_t *start, size_t size);
+
+    /** Handle initialization sequence responses. */
+    bool parse_init(uint8_t *start, size_t size);
+
     /** Handle unsolicited result codes. */
     bool parse_urc(uint8_t *start, size_t size);
 
@@ -489,6 +1172,13 @@ private:
     /** Data is being written from the send buffer. */
     void parse_socket_send(uint8_t *start, size_t size);
 
+    /** Invoke the GNSS callback. */
+    inline void emit_gnss(const gnss_t *fix)
+    {
+        if (gnss_cb)
+            gnss_cb(fix, gnss_cb_user);
+    }
+
     /** Invoke the state callback .*/
     inline void emit_state(State state)
     {
@@ -547,6 +1237,12 @@ private:
     /** User private data for error callback. */
     void *error_cb_user = nullptr;
 
+    /** User function to call on a new GNSS fix. */
+    void (*gnss_cb)(const gnss_t *fix, void *user) = nullptr;
+
+    /** User private data for GNSS callback. */
+    void *gnss_cb_user = nullptr;
+
     /** Receive buffer. */
     uint8_t buffer[kBufferSize];
 
@@ -568,9 +1264,24 @@ private:
     /** GPRS service status reported by AT+CGATT? */
     uint8_t modem_cgatt = 0;
 
+    /** Preferred mode set by AT+CNMP. */
+    uint8_t modem_mode = 2;
+
+    /** Time of the next registration poll. */
+    uint32_t registration_timer = 0;
+
     /** Local IP address reported by AT+CIFSR. */
     char modem_cifsr[32];
 
+    /** Navigation information reported by AT+CGNSINF. */
+    gnss_t modem_gnss = {};
+
+    /** Serving cell information reported by AT+CPSI? */
+    cpsi_t modem_cpsi = {};
+
+    /** Time of the next AT+CPSI? poll. */
+    uint32_t cpsi_timer = 0;
+
     /** The next valid line will be the CIFSR results. */
     bool cifsr_flag = false;
 
@@ -589,6 +1300,32 @@ private:
     /** Time the pending command will expire. */
     uint32_t command_timer = 0;
 
+    /** Time the pending command was sent. */
+    uint32_t command_start = 0;
+
+    /** Latency estimate of a command class. */
+    struct Latency {
+        int32_t srtt = 0; /**< Smoothed latency (ms x8). */
+        int32_t rttvar = 0; /**< Smoothed deviation (ms x8). */
+        uint8_t samples = 0; /**< Number of samples, saturating. */
+        uint8_t backoff = 0; /**< Timeouts since the last sample. */
+    };
+
+    /** Latency of each Timing class. */
+    Latency latency[kTimingClasses];
+
+    /** Learn timeouts from latency. */
+    bool adaptive_timeouts = true;
+
+    /** Skip the next sample, it may be a late response. */
+    bool skip_sample = false;
+
+    /** True if a command was abandoned before the modem answered it. */
+    bool resync_flag = false;
+
+    /** True once the answer to the resync command has started. */
+    bool resync_marker = false;
+
     /** Time of the next state update. */
     uint32_t update_timer = 0;
 
@@ -613,7 +1350,46 @@ private:
     /** Number of bytes that have been read from 'tx_buffer'. */
     size_t tx_index = 0;
 
-    /** Tracks the space in the modem's tx buffer. */
+    /** Largest chunk to send with AT+CIPSEND. */
+    size_t chunk_size = kSocketMax;
+
+    /** Smoothed send failure rate (1/256). */
+    uint16_t chunk_loss = 0;
+
+    /** Scheduling priority of 'tx_buffer'. */
+    Priority tx_priority = Priority::urgent;
+
+    /** True while a bulk send is deferred. */
+    bool tx_hold = false;
+
+    /** Time the current deferral started. */
+    uint32_t tx_hold_timer = 0;
+
+    /** True once the deferral ran out, until the link recovers. */
+    bool tx_hold_expired = false;
+
+    /** Minimum RSRP to send bulk data (dBm). */
+    int16_t bulk_rsrp = -110;
+
+    /** Minimum SINR to send bulk data (dB). */
+    int16_t bulk_sinr = -20;
+
+    /** Longest time to defer a bulk send (ms). */
+    uint32_t bulk_max_defer = 300000;
+
+    /** Receive share of the socket. */
+    uint8_t rx_share = 1;
+
+    /** Send share of the socket. */
+    uint8_t tx_share = 1;
+
+    /** Bytes read while contended, scaled by 1/rx_share. */
+    uint32_t rx_vtime = 0;
+
+    /** Bytes sent while contended, scaled by 1/tx_share. */
+    uint32_t tx_vtime = 0;
+
+    /** Space in the modem's tx buffer, less the chunks in flight. */
     size_t modem_tx_available = 0;
 
     /** User buffer to receive into. */
@@ -633,6 +1409,141 @@ private:
 
     /** True if the modem responds to 'AT'. */
     bool probe_flag = false;
+
+    /** Index of the baud rate being probed. */
+    uint8_t baud_index = 0;
+
+    /** Host baud rate set by autobaud detection, or 0 if unchanged. */
+    uint32_t baud_rate = 0;
+
+    /** True once the modem answered at the current baud rate. */
+    bool baud_locked = false;
+
+    /** State of the application network. */
+    PdpStep pdp_step = PdpStep::inactive;
+
+    /** IP address of the application network. */
+    char pdp_ip[16] = {};
+
+    /** Initialization steps applied since the last modem reset. */
+    uint16_t init_done = 0;
+
+    /** Initialization steps waiting for a response. */
+    uint16_t init_queued = 0;
+
+    /** Initialization steps the modem rejected after every retry. */
+    uint16_t init_failed = 0;
+
+    /** Rejections of each initialization step since the last reset. */
+    uint8_t init_errors[16] = {};
+
+    /** Number of consecutive command timeouts. */
+    uint8_t timeout_count = 0;
+
+    /** Number of watchdog resets since the modem was last ready. */
+    uint8_t watchdog_count = 0;
+
+    /** Time of the last response, or of the last idle period (ms). */
+    uint32_t silence_timer = 0;
+
+    /** Time of the first watchdog reset of the current stall. */
+    uint32_t stall_timer = 0;
+
+    /** Duration of the last watchdog recovery (ms). */
+    uint32_t recovery_ms = 0;
+
+    /** Bytes read from the socket. */
+    uint64_t rx_total_count = 0;
+
+    /** Bytes sent through the socket. */
+    uint64_t tx_total_count = 0;
+
+    /** Last +CME ERROR code. */
+    int cme_error = 0;
+
+    /** Current file transfer step. */
+    FsStep fs_step = FsStep::idle;
+
+    /** Direction of the current file transfer. */
+    FsStep fs_op = FsStep::idle;
+
+    /** Result reported when AT+CFSTERM returns. */
+    Event fs_result = Event::fs_complete;
+
+    /** Directory of the current file transfer. */
+    Directory fs_dir = Directory::custapp;
+
+    /** Name of the file being transferred. */
+    char fs_name[48];
+
+    /** User buffer to write the file from. */
+    const uint8_t *fs_tx_buffer = nullptr;
+
+    /** User buffer to read the file into. */
+    uint8_t *fs_rx_buffer = nullptr;
+
+    /** Size of the user buffer. */
+    size_t fs_size = 0;
+
+    /** Number of bytes transferred. */
+    size_t fs_index = 0;
+
+    /** Position in the file the transfer started at. */
+    size_t fs_offset = 0;
+
+    /** Number of bytes transferred by the current chunk. */
+    size_t fs_chunk = 0;
+
+    /** Number of raw bytes left in the current AT+CFSRFILE response. */
+    size_t fs_rx_pending = 0;
+
+    /** Append to the file instead of replacing it. */
+    bool fs_append = false;
+
+    /** Current HTTP client step. */
+    HttpStep http_step = HttpStep::idle;
+
+    /** Number of queued HTTP client commands awaiting a response. */
+    uint8_t http_queued = 0;
+
+    /** HTTP status code of the last response. */
+    uint16_t http_code = 0;
+
+    /** Path of the resource being downloaded. */
+    char http_path[64];
+
+    /** User buffer to download into. */
+    uint8_t *http_buffer = nullptr;
+
+    /** Size of 'http_buffer'. */
+    size_t http_size = 0;
+
+    /** Number of bytes that have been written to 'http_buffer'. */
+    size_t http_index = 0;
+
+    /** Position in the resource the download started at. */
+    size_t http_offset = 0;
+
+    /** Body length of the current response. */
+    size_t http_length = 0;
+
+    /** Number of bytes requested by the current range. */
+    size_t http_range = 0;
+
+    /** Number of body bytes read from the current response. */
+    size_t http_pos = 0;
+
+    /** Number of raw bytes left in the current AT+SHREAD response. */
+    size_t http_rx_pending = 0;
+
+    /** True if AT+CGNSINF should be polled. */
+    bool gnss_polling = false;
+
+    /** Time between AT+CGNSINF polls (ms). */
+    uint32_t gnss_interval = 0;
+
+    /** Time of the next AT+CGNSINF poll. */
+    uint32_t gnss_timer = 0;
 };
 
 } // namespace gsm
@@ -19,6 +19,7 @@
 #warning NOVAGSM_BUFFER_SIZE must be at least 256
 #endif
 
+#include <cstddef>
 #include <cstdint>
 
 namespace gsm {
@@ -51,6 +52,28 @@ public:
      */
     void load(const uint8_t *data, size_t size);
 
+    /**
+     * @brief Treat the next 'size' bytes as raw data.
+     *
+     * Raw data is passed to the parse callback as a single packet regardless
+     * of line endings, or in pieces if it does not fit in the buffer. May be
+     * called from the parse callback.
+     *
+     * @param [in] size - number of bytes, or 0 to cancel.
+     */
+    inline void expect(size_t size)
+    {
+        raw_count = size;
+    }
+
+    /**
+     * @brief Number of bytes discarded as line noise.
+     */
+    inline size_t discarded() const
+    {
+        return discard_count;
+    }
+
 private:
     /**
      * @brief Attempt to parse a packet.
@@ -62,6 +85,26 @@ private:
      */
     int try_parse(uint8_t *data, size_t size);
 
+    /**
+     * @brief Find the next plausible line start after framing is lost.
+     *
+     * A line start is a '\r' or '\n' followed by '+', 'OK', 'ERROR' or one of
+     * the other tokens the modem begins a response with. If none is found
+     * everything but a trailing '\r' is skipped.
+     *
+     * @param [in] data - buffer.
+     * @param [in] size - length of buffer.
+     * @return number of bytes to skip.
+     */
+    size_t resync(const uint8_t *data, size_t size) const;
+
+    /**
+     * @brief Drop bytes from the front of the buffer.
+     *
+     * @param [in] size - number of bytes to drop.
+     */
+    void discard(size_t size);
+
     /**
      * @brief Invoke the parse callback.
      *
@@ -84,6 +127,8 @@ private:
     size_t count = 0;               /**< The number of bytes in the buffer. */
     size_t head = 0;                /**< Response write pointer. */
     size_t tail = 0;                /**< Response read pointer. */
+    size_t discard_count = 0;       /**< Bytes discarded as noise. */
+    size_t raw_count = 0;           /**< Raw bytes still expected. */
 };
 
 } // namespace gsm
@@ -0,0 +1,134 @@
+/**
+ * @file serial.h
+ * @brief Low latency Linux serial port for the driver.
+ * @author Wilkins White
+ * @copyright 2024 Nova Dynamics LLC
+ */
+
+#ifndef NOVAGSM_SERIAL_H_
+#define NOVAGSM_SERIAL_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "modem.h"
+
+namespace gsm {
+
+/**
+ * @brief Serial port implementing context_t on Linux.
+ *
+ * open() puts the TTY in raw mode at the same input and output speed,
+ * takes an exclusive lock, and requests ASYNC_LOW_LATENCY so the kernel
+ * hands over received bytes without the usual 10-16 ms delay. Reads never
+ * block; poll fd() to sleep until data arrives. Writes wait for the port
+ * to accept every byte, e.g. while CTS holds off the transmitter.
+ *
+ * context_t has no private data, so the callbacks returned by context()
+ * operate on the active port: the first port opened, or the port running
+ * process(). Use process() when driving more than one port.
+ *
+ * Only available on Linux, open() returns -ENOSYS elsewhere.
+ */
+class Serial {
+public:
+    /** Constructor. */
+    Serial() = default;
+
+    /** Destructor. */
+    ~Serial();
+
+    Serial(const Serial&) = delete;
+    Serial &operator=(const Serial&) = delete;
+
+    /**
+     * @brief Open and configure a TTY.
+     *
+     * @param [in] path - device path, e.g. "/dev/ttyUSB2".
+     * @param [in] baud - baud rate.
+     * @param [in] flow - enable RTS/CTS hardware flow control.
+     * @return -EALREADY if a port is already open.
+     * @return -EINVAL if the baud rate is not supported.
+     * @return -EBUSY if another process holds the port.
+     * @return a negative errno if the port cannot be configured.
+     */
+    int open(const char *path, uint32_t baud = 115200, bool flow = false);
+
+    /** Close the port. */
+    void close();
+
+    /**
+     * @brief Change the baud rate.
+     *
+     * @param [in] baud - new baud rate.
+     * @return -ENOTCONN if the port is not open.
+     * @return -EINVAL if the baud rate is not supported.
+     */
+    int set_baud(uint32_t baud);
+
+    /**
+     * @brief Run a driver against this port.
+     *
+     * @param [in] modem - driver created with context().
+     */
+    void process(Modem &modem);
+
+    /**
+     * @brief Returns the file descriptor to poll for input, or -1.
+     */
+    inline int fd() const
+    {
+        return port_fd;
+    }
+
+    /**
+     * @brief Returns true if low latency mode was enabled.
+     */
+    inline bool low_latency() const
+    {
+        return latency_set;
+    }
+
+    /**
+     * @brief Returns a context for the active port.
+     *
+     * Uses the monotonic clock for millis and supports baud rate
+     * detection through set_baud. The port's baud rate and flow control
+     * are passed on so the modem is configured to match.
+     */
+    static context_t context();
+
+    /**
+     * @brief Milliseconds from the monotonic clock.
+     */
+    static uint32_t millis();
+
+private:
+    /** Read callback for context(). */
+    static int read(void *data, size_t size);
+
+    /** Write callback for context(). */
+    static int write(const void *data, size_t size);
+
+    /** Baud rate callback for context(). */
+    static void change_baud(uint32_t baud);
+
+    /** Port used by the context() callbacks. */
+    static Serial *active;
+
+    /** File descriptor. */
+    int port_fd = -1;
+
+    /** True if ASYNC_LOW_LATENCY was set. */
+    bool latency_set = false;
+
+    /** Current baud rate. */
+    uint32_t port_baud = 0;
+
+    /** True if RTS/CTS flow control is enabled. */
+    bool port_flow = false;
+};
+
+} // namespace gsm
+
+#endif // NOVAGSM_SERIAL_H_
@@ -0,0 +1,67 @@
+/**
+ * @file sha256.h
+ * @brief Incremental SHA-256 hash.
+ * @author Wilkins White
+ * @copyright 2024 Nova Dynamics LLC
+ */
+
+#ifndef NOVAGSM_SHA256_H_
+#define NOVAGSM_SHA256_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace gsm {
+
+/** Size of a SHA-256 digest in bytes. */
+constexpr size_t kSha256Size = 32;
+
+/**
+ * @brief Incremental SHA-256 hash.
+ *
+ * Uses the SHA extensions of x86 or ARMv8 processors when they are
+ * available. The object holds no pointers and may be copied to save the
+ * progress of a hash.
+ */
+class Sha256 {
+public:
+    /** Constructor. */
+    Sha256();
+
+    /** Start a new hash. */
+    void reset();
+
+    /**
+     * @brief Add data to the hash.
+     *
+     * @param [in] data - buffer to hash.
+     * @param [in] size - length of buffer.
+     */
+    void update(const void *data, size_t size);
+
+    /**
+     * @brief Finish the hash.
+     *
+     * The object must be reset() before it is used again.
+     *
+     * @param [out] digest - buffer of at least kSha256Size bytes.
+     */
+    void finish(uint8_t *digest);
+
+    /**
+     * @brief Returns the number of bytes hashed.
+     */
+    inline uint64_t size() const
+    {
+        return length;
+    }
+
+private:
+    uint32_t state[8]; /**< Intermediate hash value. */
+    uint64_t length = 0; /**< Number of bytes hashed. */
+    uint8_t buffer[64]; /**< Partial block. */
+};
+
+} // namespace gsm
+
+#endif // NOVAGSM_SHA256_H_
@@ -0,0 +1,118 @@
+/**
+ * @file status.h
+ * @brief Shared memory status board.
+ * @author Wilkins White
+ * @copyright 2024 Nova Dynamics LLC
+ */
+
+#ifndef NOVAGSM_STATUS_H_
+#define NOVAGSM_STATUS_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "modem.h"
+
+namespace gsm {
+
+/** Snapshot of a driver published by StatusBoard. */
+typedef struct {
+    uint32_t count; /**< Number of snapshots published. */
+    uint8_t state; /**< Driver state, see State. */
+    uint8_t csq; /**< Signal quality, see Modem::csq(). */
+    uint8_t creg; /**< GSM registration, see Modem::creg(). */
+    uint8_t cereg; /**< LTE registration, see Modem::cereg(). */
+    uint8_t cgatt; /**< GPRS attachment, see Modem::cgatt(). */
+    int16_t rsrp; /**< Serving cell RSRP, see Modem::cpsi(). */
+    int16_t sinr; /**< Serving cell SINR, see Modem::cpsi(). */
+    char cifsr[16]; /**< Local IP address, see Modem::cifsr(). */
+    uint64_t rx_total; /**< Bytes read from the socket. */
+    uint64_t tx_total; /**< Bytes sent through the socket. */
+    uint32_t discarded; /**< Bytes discarded as line noise. */
+    int32_t last_error; /**< Last +CME ERROR code. */
+} status_t;
+
+/**
+ * @brief Publishes driver status to a POSIX shared memory segment.
+ *
+ * The driver thread writes a snapshot after Modem::process() and any
+ * number of monitor processes read it without locks or system calls. The
+ * snapshot is guarded by a sequence counter (seqlock): the writer makes
+ * the counter odd while copying and readers retry until they see the same
+ * even value before and after their copy.
+ *
+ * Not available on platforms without shm_open(); open() and attach()
+ * return -ENOSYS there.
+ */
+class StatusBoard {
+public:
+    /** Constructor. */
+    StatusBoard() = default;
+
+    /** Destructor. */
+    ~StatusBoard();
+
+    StatusBoard(const StatusBoard&) = delete;
+    StatusBoard &operator=(const StatusBoard&) = delete;
+
+    /**
+     * @brief Create the segment for publishing.
+     *
+     * The segment is removed again by close().
+     *
+     * @param [in] name - segment name, e.g. "/novagsm0".
+     * @return -EINVAL if name is null.
+     * @return -EALREADY if a segment is already open.
+     * @return a negative errno if the segment cannot be created.
+     */
+    int open(const char *name);
+
+    /**
+     * @brief Map an existing segment for reading.
+     *
+     * @param [in] name - segment name.
+     * @return -EINVAL if name is null.
+     * @return -EALREADY if a segment is already open.
+     * @return -EPROTO if the segment is not a status board.
+     * @return a negative errno if the segment cannot be opened.
+     */
+    int attach(const char *name);
+
+    /** Unmap the segment, removing it if it was created by open(). */
+    void close();
+
+    /**
+     * @brief Write a snapshot of the driver.
+     *
+     * Wait-free; does nothing unless the segment was created by open().
+     *
+     * @param [in] modem - driver to publish.
+     */
+    void publish(const Modem &modem);
+
+    /**
+     * @brief Read the latest snapshot.
+     *
+     * @param [out] status - snapshot.
+     * @return -ENOTCONN if no segment is open.
+     * @return -EBUSY if the writer kept the snapshot locked.
+     */
+    int read(status_t &status) const;
+
+private:
+    /** Segment layout. */
+    struct Segment;
+
+    /** Mapped segment. */
+    Segment *segment = nullptr;
+
+    /** Segment name to remove on close(), if created. */
+    char path[32] = {};
+
+    /** True if the segment was created by open(). */
+    bool owner = false;
+};
+
+} // namespace gsm
+
+#endif // NOVAGSM_STATUS_H_
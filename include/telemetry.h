@@ -0,0 +1,166 @@
+/**
+ * @file telemetry.h
+ * @brief Columnar telemetry batch codec.
+ * @author Wilkins White
+ * @copyright 2024 Nova Dynamics LLC
+ */
+
+#ifndef NOVAGSM_TELEMETRY_H_
+#define NOVAGSM_TELEMETRY_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "modem.h"
+
+namespace gsm {
+
+/**
+ * @brief Collects timestamped samples and encodes them as compact batches.
+ *
+ * A sample is a timestamp and a fixed number of integer values. Batches are
+ * encoded column by column: timestamps as delta-of-delta and each value
+ * column as deltas, all as zigzag varints. Periodic readings that change
+ * slowly encode to one or two bytes per value.
+ *
+ * Batch layout:
+ *
+ *     varint columns
+ *     varint rows
+ *     varint t[0], zigzag t[1]-t[0], zigzag (t[i]-t[i-1])-(t[i-1]-t[i-2])...
+ *     for each column: zigzag v[0], zigzag v[i]-v[i-1]...
+ *
+ * Arithmetic wraps modulo 2^32 so every field fits in five bytes.
+ *
+ * All storage is provided by the caller.
+ */
+class Telemetry {
+public:
+    /**
+     * @brief Constructor.
+     *
+     * @param [in] columns - number of values in each sample.
+     * @param [in] samples - storage for capacity * (columns + 1) values.
+     * @param [in] capacity - maximum number of samples in a batch.
+     * @param [in] buffer - storage for the encoded batch.
+     * @param [in] size - length of buffer.
+     */
+    Telemetry(
+            uint8_t columns,
+            int32_t *samples,
+            size_t capacity,
+            uint8_t *buffer,
+            size_t size);
+
+    /**
+     * @brief Add a sample to the batch.
+     *
+     * @param [in] timestamp - sample time, e.g. in ms.
+     * @param [in] values - 'columns' values.
+     * @return -EINVAL if values is null.
+     * @return -ENOBUFS if the batch is full.
+     */
+    int add(uint32_t timestamp, const int32_t *values);
+
+    /**
+     * @brief Encode the batch into the buffer and start a new batch.
+     *
+     * @return length of the encoded batch, see data().
+     * @return -ENOBUFS if the buffer is too small, the batch is kept.
+     */
+    int encode();
+
+    /**
+     * @brief Encode the batch and pass it to Modem::send().
+     *
+     * The buffer is not touched again until the next encode(), so it is
+     * safe to keep adding samples while the send is in progress.
+     *
+     * @param [in] modem - driver to send through.
+     * @param [in] priority - send priority.
+     * @return -EBUSY if a send is already in progress.
+     * @return -ENODATA if the batch is empty.
+     * @return -ENOBUFS if the buffer is too small, the batch is kept.
+     * @return -ENOTCONN if a connection is not established.
+     */
+    int send(Modem &modem, Priority priority = Priority::bulk);
+
+    /**
+     * @brief Decode a batch.
+     *
+     * @param [in] data - encoded batch.
+     * @param [in] size - length of data.
+     * @param [in] columns - expected number of values in each sample.
+     * @param [out] timestamps - storage for 'capacity' timestamps.
+     * @param [out] values - storage for capacity * columns values.
+     * @param [in] capacity - maximum number of samples to decode.
+     * @return number of samples decoded.
+     * @return -EINVAL if the batch is malformed or has other columns.
+     * @return -ENOBUFS if the batch has more than 'capacity' samples.
+     */
+    static int decode(
+            const uint8_t *data,
+            size_t size,
+            uint8_t columns,
+            uint32_t *timestamps,
+            int32_t *values,
+            size_t capacity);
+
+    /**
+     * @brief Returns the number of samples in the batch.
+     */
+    inline size_t count() const
+    {
+        return rows;
+    }
+
+    /**
+     * @brief Returns true if no more samples can be added.
+     */
+    inline bool full() const
+    {
+        return rows >= row_capacity;
+    }
+
+    /**
+     * @brief Returns the last encoded batch.
+     */
+    inline const uint8_t *data() const
+    {
+        return out_buffer;
+    }
+
+    /**
+     * @brief Returns the length of the last encoded batch.
+     */
+    inline size_t size() const
+    {
+        return out_count;
+    }
+
+private:
+    /** Number of values in each sample. */
+    uint8_t column_count;
+
+    /** Sample storage, one timestamp followed by the values per row. */
+    int32_t *sample_buffer;
+
+    /** Maximum number of samples. */
+    size_t row_capacity;
+
+    /** Number of samples in the batch. */
+    size_t rows = 0;
+
+    /** Encoded batch storage. */
+    uint8_t *out_buffer;
+
+    /** Length of out_buffer. */
+    size_t out_size;
+
+    /** Length of the last encoded batch. */
+    size_t out_count = 0;
+};
+
+} // namespace gsm
+
+#endif // NOVAGSM_TELEMETRY_H_
@@ -0,0 +1,196 @@
+/**
+ * @file uring.h
+ * @brief Batched serial I/O for many modems with io_uring.
+ * @author Wilkins White
+ * @copyright 2024 Nova Dynamics LLC
+ */
+
+#ifndef NOVAGSM_URING_H_
+#define NOVAGSM_URING_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "modem.h"
+
+namespace gsm {
+
+/**
+ * @brief Serves the serial ports of a pool of modems through one io_uring.
+ *
+ * Each modem gets a slot holding a read buffer and a write buffer. poll()
+ * queues a read for every slot whose read buffer is empty and a write for
+ * every slot with data waiting, submits them all with a single
+ * io_uring_enter() and then reaps the completions. process() runs a
+ * modem's parser on the data its slot has collected.
+ *
+ * context_t has no private data, so the callbacks returned by context()
+ * operate on the slot being processed by process(). They must only be
+ * used through process() and from one thread.
+ *
+ * File descriptors should be opened without O_NONBLOCK so the kernel
+ * waits for data instead of failing reads with -EAGAIN.
+ *
+ * Only available on Linux, open() returns -ENOSYS elsewhere.
+ */
+class UringPool {
+public:
+    /** Constructor. */
+    UringPool() = default;
+
+    /** Destructor. */
+    ~UringPool();
+
+    UringPool(const UringPool&) = delete;
+    UringPool &operator=(const UringPool&) = delete;
+
+    /**
+     * @brief Create the ring.
+     *
+     * @param [in] slots - maximum number of modems.
+     * @return -EALREADY if the ring is already open.
+     * @return -EINVAL if slots is 0.
+     * @return a negative errno if the ring cannot be created.
+     */
+    int open(size_t slots);
+
+    /** Destroy the ring, abandoning all slots. */
+    void close();
+
+    /**
+     * @brief Add a serial port to the pool.
+     *
+     * @param [in] fd - open serial port.
+     * @return slot index.
+     * @return -ENOTCONN if the ring is not open.
+     * @return -ENOSPC if every slot is in use.
+     */
+    int add(int fd);
+
+    /**
+     * @brief Remove a serial port from the pool.
+     *
+     * Requests in flight are cancelled; the slot becomes free once they
+     * complete. The caller still owns the descriptor.
+     *
+     * @param [in] slot - slot index returned by add().
+     */
+    void remove(int slot);
+
+    /**
+     * @brief Submit queued reads and writes and reap completions.
+     *
+     * @param [in] timeout - longest time to wait for a completion (ms), or
+     * 0 to return immediately.
+     * @return number of completions reaped.
+     * @return -ENOTCONN if the ring is not open.
+     * @return a negative errno if io_uring_enter() fails.
+     */
+    int poll(uint32_t timeout = 0);
+
+    /**
+     * @brief Run a modem against its slot.
+     *
+     * @param [in] slot - slot index returned by add().
+     * @param [in] modem - driver created with context().
+     */
+    void process(int slot, Modem &modem);
+
+    /**
+     * @brief Returns the error that stopped a slot, or 0.
+     *
+     * A slot stops when a read or write fails, or with -EPIPE when the
+     * port hangs up. poll() no longer reads or writes a stopped slot; it
+     * should be removed with remove().
+     */
+    int error(int slot) const;
+
+    /**
+     * @brief Returns a context whose read and write use the pool.
+     *
+     * @param [in] millis - time source for the driver.
+     */
+    static context_t context(uint32_t (*millis)());
+
+private:
+    /** Serial port state. */
+    struct Slot {
+        int fd = -1; /**< Serial port, or -1 if free. */
+        bool closing = false; /**< Waiting for requests to finish. */
+        bool reading = false; /**< A read is in flight. */
+        int status = 0; /**< Error that stopped the slot, or 0. */
+        size_t rx_count = 0; /**< Bytes in rx_buffer. */
+        size_t rx_index = 0; /**< Bytes already passed to the driver. */
+        size_t tx_count = 0; /**< Bytes in tx_buffer. */
+        size_t tx_flight = 0; /**< Bytes of tx_buffer being written. */
+        uint8_t rx_buffer[kBufferSize]; /**< Completed read. */
+        uint8_t tx_buffer[kBufferSize * 2]; /**< Pending writes. */
+    };
+
+    /** Queue a request, returns false if the submission queue is full. */
+    bool push(
+            uint8_t op,
+            int fd,
+            void *data,
+            size_t size,
+            uint64_t off,
+            uint64_t user);
+
+    /** Handle a completion. */
+    void complete(uint64_t user, int32_t result);
+
+    /** Read callback for context(). */
+    static int read(void *data, size_t size);
+
+    /** Write callback for context(). */
+    static int write(const void *data, size_t size);
+
+    /** Slot being processed by process(). */
+    static Slot *current;
+
+    /** Slots. */
+    std::vector<Slot> slots;
+
+    /** io_uring file descriptor. */
+    int ring_fd = -1;
+
+    /** Submission queue ring mapping. */
+    void *sq_map = nullptr;
+
+    /** Length of sq_map. */
+    size_t sq_map_size = 0;
+
+    /** Completion queue ring mapping (may alias sq_map). */
+    void *cq_map = nullptr;
+
+    /** Length of cq_map. */
+    size_t cq_map_size = 0;
+
+    /** Submission queue entries. */
+    void *sqe_map = nullptr;
+
+    /** Length of sqe_map. */
+    size_t sqe_map_size = 0;
+
+    /** Ring pointers within the mappings. */
+    uint32_t *sq_head = nullptr;
+    uint32_t *sq_tail = nullptr;
+    uint32_t *sq_array = nullptr;
+    uint32_t sq_mask = 0;
+    uint32_t sq_entries = 0;
+    uint32_t *cq_head = nullptr;
+    uint32_t *cq_tail = nullptr;
+    uint32_t cq_mask = 0;
+    void *cqes = nullptr;
+
+    /** Entries queued since the last io_uring_enter(). */
+    uint32_t queued = 0;
+
+    /** Timeout for poll(), read by the kernel on submission. */
+    int64_t wait_time[2] = {};
+};
+
+} // namespace gsm
+
+#endif // NOVAGSM_URING_H_
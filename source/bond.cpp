@@ -0,0 +1,331 @@
+/**
+ * @file bond.cpp
+ * @brief Stripes one stream across several modems.
+ * @author Wilkins White
+ * @copyright 2024 Nova Dynamics LLC
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <errno.h>
+
+#include "bond.h"
+#include "debug.h"
+
+namespace gsm {
+
+Bond::Bond(uint32_t (*millis)()) : millis(millis)
+{
+}
+
+int Bond::add(Modem &modem)
+{
+    if (link_count >= kBondLinks)
+        return -ENOSPC;
+
+    links[link_count].modem = &modem;
+    return link_count++;
+}
+
+void Bond::set_receive_callback(bond_cb_t func, void *user)
+{
+    receive_cb = func;
+    receive_user = user;
+}
+
+int Bond::send(const void *data, size_t size)
+{
+    if (size == 0)
+        return -EINVAL;
+
+    if (tx_busy())
+        return -EBUSY;
+
+    bool connected = false;
+    for (size_t i = 0; i < link_count; ++i)
+        connected |= links[i].modem->connected();
+
+    if (!connected)
+        return -ENOTCONN;
+
+    tx_buffer = static_cast<const uint8_t*>(data);
+    tx_size = size;
+    tx_index = 0;
+    tx_done = 0;
+    retry_count = 0;
+    return 0;
+}
+
+void Bond::stop_send()
+{
+    for (size_t i = 0; i < link_count; ++i) {
+        Link &link = links[i];
+        if (link.busy) {
+            link.modem->stop_send();
+            link.busy = false;
+        }
+    }
+
+    // Sequence numbers already used are skipped by the far end
+    tx_buffer = nullptr;
+    retry_count = 0;
+}
+
+uint32_t Bond::goodput(size_t link) const
+{
+    return (link < link_count) ? links[link].goodput : 0;
+}
+
+void Bond::process()
+{
+    const uint32_t now = millis();
+
+    for (size_t i = 0; i < link_count; ++i) {
+        check(links[i]);
+        receive(links[i]);
+    }
+
+    if (tx_buffer == nullptr)
+        return;
+
+    for (size_t i = 0; i < link_count; ++i) {
+        Link &link = links[i];
+        if (!link.busy && link.modem->connected() && eligible(link, now))
+            transmit(link);
+    }
+
+    bool busy = (tx_index < tx_size) || (retry_count > 0);
+    for (size_t i = 0; i < link_count; ++i)
+        busy |= links[i].busy;
+
+    if (!busy) {
+        LOG_VERBOSE("Bond sent %lu bytes\r\n", (unsigned long) tx_done);
+        tx_buffer = nullptr;
+    }
+}
+
+bool Bond::eligible(const Link &link, uint32_t now) const
+{
+    // Not measured yet
+    if (link.goodput == 0)
+        return true;
+
+    uint32_t others = 0;
+    for (size_t i = 0; i < link_count; ++i) {
+        const Link &other = links[i];
+        if (&other != &link && other.modem->connected())
+            others += other.goodput;
+    }
+
+    if ((uint64_t)link.goodput * (kBondWindow - 1) >= others)
+        return true;
+
+    return (int32_t)(now - link.timer) >= (int32_t)kBondProbe;
+}
+
+void Bond::transmit(Link &link)
+{
+    Frame frame;
+    if (retry_count > 0) {
+        // Oldest first, the far end is waiting on it
+        frame = retry[0];
+        retry_count -= 1;
+        memmove(retry, retry + 1, retry_count * sizeof(Frame));
+    }
+    else if (tx_index < tx_size) {
+        frame.seq = tx_seq++;
+        frame.offset = tx_index;
+        frame.size = std::min(kBondPayload, tx_size - tx_index);
+        tx_index += frame.size;
+    }
+    else {
+        return;
+    }
+
+    // +---------------------------------------+
+    // | seq (4) | size (2) | payload (size)   |
+    // +---------------------------------------+
+    link.tx[0] = frame.seq >> 24;
+    link.tx[1] = frame.seq >> 16;
+    link.tx[2] = frame.seq >> 8;
+    link.tx[3] = frame.seq;
+    link.tx[4] = frame.size >> 8;
+    link.tx[5] = frame.size;
+    memcpy(link.tx + kBondHeader, tx_buffer + frame.offset, frame.size);
+
+    link.modem->send(link.tx, kBondHeader + frame.size);
+    link.frame = frame;
+    link.busy = true;
+    link.timer = millis();
+}
+
+void Bond::check(Link &link)
+{
+    if (!link.busy)
+        return;
+
+    if (!link.modem->connected()) {
+        LOG_WARN("Bond link dropped, resending frame %lu\r\n",
+            (unsigned long) link.frame.seq);
+
+        link.modem->stop_send();
+        link.busy = false;
+
+        // Each link holds at most one frame so this cannot overflow
+        retry[retry_count++] = link.frame;
+        return;
+    }
+
+    const size_t size = kBondHeader + link.frame.size;
+    if (link.modem->tx_busy() || link.modem->tx_count() != size)
+        return;
+
+    const uint32_t elapsed = std::max<uint32_t>(millis() - link.timer, 1);
+    const uint32_t sample = (uint64_t)size * 1000 / elapsed;
+
+    if (link.goodput == 0)
+        link.goodput = sample;
+    else
+        link.goodput = link.goodput - link.goodput / 4 + sample / 4;
+
+    tx_done += link.frame.size;
+    link.busy = false;
+}
+
+void Bond::receive(Link &link)
+{
+    Modem &modem = *link.modem;
+
+    if (!modem.connected()) {
+        // A partial frame is lost with the connection
+        modem.stop_receive();
+        link.header_count = 0;
+        link.payload_size = 0;
+        link.payload_count = 0;
+        return;
+    }
+
+    if (modem.rx_busy())
+        return;
+
+    const size_t count = modem.rx_count();
+    if (count > 0) {
+        modem.stop_receive();
+        parse(link, link.rx, count);
+
+        // parse() closes the link on a framing error
+        if (!modem.connected())
+            return;
+    }
+
+    const size_t size = std::min<size_t>(
+            modem.rx_available(), sizeof(link.rx));
+
+    if (size > 0)
+        modem.receive(link.rx, size);
+}
+
+void Bond::parse(Link &link, const uint8_t *data, size_t size)
+{
+    while (size > 0) {
+        if (link.header_count < kBondHeader) {
+            const size_t count = std::min(
+                    kBondHeader - link.header_count, size);
+
+            memcpy(link.header + link.header_count, data, count);
+            link.header_count += count;
+            data += count;
+            size -= count;
+
+            if (link.header_count < kBondHeader)
+                break;
+
+            link.payload_size = (link.header[4] << 8) | link.header[5];
+            link.payload_count = 0;
+
+            if (link.payload_size == 0 || link.payload_size > kBondPayload) {
+                // No way to find the next frame, start over
+                LOG_ERROR("Bond framing error (%lu bytes)\r\n",
+                    (unsigned long) link.payload_size);
+
+                link.header_count = 0;
+                link.modem->close();
+                return;
+            }
+        }
+
+        const size_t count = std::min(
+                link.payload_size - link.payload_count, size);
+
+        memcpy(link.payload + link.payload_count, data, count);
+        link.payload_count += count;
+        data += count;
+        size -= count;
+
+        if (link.payload_count == link.payload_size) {
+            const uint32_t seq = ((uint32_t)link.header[0] << 24)
+                | ((uint32_t)link.header[1] << 16)
+                | ((uint32_t)link.header[2] << 8)
+                | link.header[3];
+
+            accept(seq, link.payload, link.payload_size);
+            link.header_count = 0;
+        }
+    }
+}
+
+void Bond::accept(uint32_t seq, const uint8_t *data, size_t size)
+{
+    // Already delivered, e.g. resent after a link dropped
+    if ((int32_t)(seq - rx_seq) < 0)
+        return;
+
+    // Too far ahead to buffer, give up on the missing frames
+    while ((int32_t)(seq - rx_seq) >= (int32_t)kBondWindow) {
+        Slot &slot = window[rx_seq % kBondWindow];
+        if (slot.full) {
+            if (receive_cb)
+                receive_cb(slot.data, slot.size, receive_user);
+
+            slot.full = false;
+        }
+        else {
+            LOG_WARN("Bond frame %lu lost\r\n", (unsigned long) rx_seq);
+        }
+
+        rx_seq += 1;
+    }
+
+    if (seq == rx_seq) {
+        if (receive_cb)
+            receive_cb(data, size, receive_user);
+
+        rx_seq += 1;
+        deliver();
+        return;
+    }
+
+    Slot &slot = window[seq % kBondWindow];
+    if (!slot.full) {
+        memcpy(slot.data, data, size);
+        slot.size = size;
+        slot.full = true;
+    }
+}
+
+void Bond::deliver()
+{
+    for (;;) {
+        Slot &slot = window[rx_seq % kBondWindow];
+        if (!slot.full)
+            break;
+
+        if (receive_cb)
+            receive_cb(slot.data, slot.size, receive_user);
+
+        slot.full = false;
+        rx_seq += 1;
+    }
+}
+
+} // namespace gsm
@@ -21,15 +21,13 @@ Command::Command(uint32_t timeout, std::vector<uint8_t> &payload) :
 Command::Command(uint32_t timeout, const char *data) :
         timeout_ms(timeout)
 {
-    const size_t size = strlen(data);
+    const size_t size = (data != nullptr) ? strlen(data) : 0;
     payload.reserve(size + 3);
 
     payload.push_back('A');
     payload.push_back('T');
-    if (data != nullptr) {
-        for (size_t i = 0; i < size; ++i)
-            payload.push_back(data[i]);
-    }
+    for (size_t i = 0; i < size; ++i)
+        payload.push_back(data[i]);
     payload.push_back('\r');
 }
 
@@ -66,4 +64,10 @@ void Command::append(const void *data, size_t size)
     memcpy(payload.data() + end, data, size);
 }
 
+void Command::set_response_callback(response_cb_t func, void *user)
+{
+    response_cb = func;
+    response_cb_user = user;
+}
+
 } // namespace gsm
@@ -0,0 +1,231 @@
+/**
+ * @file download.cpp
+ * @brief Streaming download with integrity verification.
+ * @author Wilkins White
+ * @copyright 2024 Nova Dynamics LLC
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <errno.h>
+
+#include "debug.h"
+#include "download.h"
+
+namespace gsm {
+
+Download::Download(Modem &modem, uint8_t *block, size_t size)
+    : modem(modem), block_buffer(block), block_size(size)
+{
+    point.offset = 0;
+}
+
+void Download::set_sink_callback(sink_cb_t func, void *user)
+{
+    sink_cb = func;
+    sink_user = user;
+}
+
+void Download::set_complete_callback(
+        void (*func)(int result, void *user), void *user)
+{
+    complete_cb = func;
+    complete_user = user;
+}
+
+int Download::start(
+        size_t size, const uint8_t *digest, const checkpoint_t *resume)
+{
+    if (busy())
+        return -EALREADY;
+
+    if (!modem.connected())
+        return -ENOTCONN;
+
+    return begin(Step::socket, nullptr, size, digest, resume);
+}
+
+int Download::start(
+        const char *path,
+        size_t size,
+        const uint8_t *digest,
+        const checkpoint_t *resume)
+{
+    if (path == nullptr)
+        return -EINVAL;
+
+    if (busy())
+        return -EALREADY;
+
+    if (!modem.http_connected())
+        return -ENOTCONN;
+
+    return begin(Step::http, path, size, digest, resume);
+}
+
+int Download::begin(
+        Step source,
+        const char *path,
+        size_t size,
+        const uint8_t *digest,
+        const checkpoint_t *resume)
+{
+    if (digest == nullptr || block_buffer == nullptr || block_size == 0)
+        return -EINVAL;
+
+    if (sink_cb == nullptr)
+        return -EINVAL;
+
+    // The checkpoint must describe a prefix of this download
+    if (resume && (resume->offset > size
+            || resume->hash.size() != resume->offset)) {
+        return -EINVAL;
+    }
+
+    if (resume) {
+        point = *resume;
+    }
+    else {
+        point.offset = 0;
+        point.hash.reset();
+    }
+
+    memcpy(expected, digest, kSha256Size);
+    http_path = path;
+    total = size;
+    pending = 0;
+    status = 0;
+    step = source;
+
+    if (point.offset > 0) {
+        LOG_INFO("Resuming download at %lu of %lu bytes\r\n",
+                (unsigned long) point.offset, (unsigned long) total);
+    }
+
+    if (point.offset == total) {
+        verify();
+        return 0;
+    }
+
+    int result = request();
+    if (result)
+        step = Step::idle;
+
+    return result;
+}
+
+void Download::stop()
+{
+    if (!busy())
+        return;
+
+    if (step == Step::socket)
+        modem.stop_receive();
+
+    LOG_WARN("Download stopped at %lu bytes\r\n",
+            (unsigned long) point.offset);
+
+    finish(-ECANCELED);
+}
+
+void Download::process()
+{
+    size_t count = 0;
+
+    switch (step) {
+    case Step::idle:
+        return;
+    case Step::socket:
+        if (modem.rx_busy())
+            return;
+
+        count = modem.rx_count();
+        modem.stop_receive();
+        break;
+    case Step::http:
+        if (modem.http_busy())
+            return;
+
+        count = modem.http_count();
+        break;
+    }
+
+    // Partial blocks are discarded so the sink only sees whole blocks
+    if (count < pending) {
+        LOG_WARN("Download interrupted at %lu bytes\r\n",
+                (unsigned long) (point.offset + count));
+
+        finish(-ECONNRESET);
+        return;
+    }
+
+    int result = commit();
+    if (result) {
+        LOG_ERROR("Sink failed at %lu bytes (%d)\r\n",
+                (unsigned long) point.offset, result);
+
+        finish(result);
+        return;
+    }
+
+    if (point.offset == total) {
+        verify();
+        return;
+    }
+
+    result = request();
+    if (result)
+        finish(result);
+}
+
+int Download::request()
+{
+    pending = std::min(block_size, total - point.offset);
+
+    if (step == Step::http) {
+        return modem.http_get(
+                http_path, block_buffer, pending, point.offset);
+    }
+
+    return modem.receive(block_buffer, pending);
+}
+
+int Download::commit()
+{
+    int result = sink_cb(point.offset, block_buffer, pending, sink_user);
+    if (result)
+        return result;
+
+    point.hash.update(block_buffer, pending);
+    point.offset += pending;
+    pending = 0;
+    return 0;
+}
+
+void Download::verify()
+{
+    // Finish a copy so the checkpoint can still be resumed
+    Sha256 hash = point.hash;
+    uint8_t digest[kSha256Size];
+    hash.finish(digest);
+
+    if (memcmp(digest, expected, kSha256Size) != 0) {
+        LOG_ERROR("Download digest mismatch\r\n");
+        finish(-EBADMSG);
+        return;
+    }
+
+    LOG_INFO("Download verified (%lu bytes)\r\n", (unsigned long) total);
+    finish(0);
+}
+
+void Download::finish(int result)
+{
+    step = Step::idle;
+    status = result;
+
+    if (complete_cb)
+        complete_cb(result, complete_user);
+}
+
+} // namespace gsm
@@ -0,0 +1,169 @@
+/**
+ * @file failover.cpp
+ * @brief Hot-standby failover between two modems.
+ * @author Wilkins White
+ * @copyright 2024 Nova Dynamics LLC
+ */
+
+#include <errno.h>
+
+#include "debug.h"
+#include "failover.h"
+
+namespace gsm {
+
+Failover::Failover(Modem &primary, Modem &secondary, uint32_t (*millis)())
+    : millis(millis)
+{
+    modems[0] = &primary;
+    modems[1] = &secondary;
+}
+
+int Failover::start(const char *apn, const char *host, unsigned int port)
+{
+    if (apn == nullptr)
+        return -EINVAL;
+
+    this->apn = apn;
+    this->host = host;
+    this->port = port;
+
+    const uint32_t now = millis();
+    retry_timer[0] = now;
+    retry_timer[1] = now;
+    signal_poor = false;
+    running = true;
+    return 0;
+}
+
+void Failover::stop()
+{
+    running = false;
+}
+
+void Failover::set_signal_threshold(uint8_t csq, int16_t rsrp, uint32_t hold)
+{
+    min_csq = csq;
+    min_rsrp = rsrp;
+    signal_hold = hold;
+}
+
+void Failover::set_switch_callback(
+        void (*func)(Modem &active, Modem &previous, void *user), void *user)
+{
+    switch_cb = func;
+    switch_user = user;
+}
+
+bool Failover::ready(const Modem &modem) const
+{
+    if (host)
+        return modem.connected();
+
+    return modem.online() || modem.handshaking()
+        || modem.connected() || modem.closing();
+}
+
+bool Failover::poor(const Modem &modem) const
+{
+    // 99 (unknown) is not treated as poor
+    const uint8_t csq = modem.csq();
+    if (min_csq > 0 && csq < min_csq)
+        return true;
+
+    const cpsi_t &cell = modem.cpsi();
+    return cell.lte && cell.rsrp < min_rsrp;
+}
+
+void Failover::process()
+{
+    if (!running)
+        return;
+
+    const uint32_t now = millis();
+
+    bring_up(0, now);
+    bring_up(1, now);
+
+    // Track the signal even without a standby, so a recovery in the
+    // meantime restarts the hold
+    if (!poor(active())) {
+        signal_poor = false;
+    }
+    else if (!signal_poor) {
+        signal_poor = true;
+        signal_timer = now;
+    }
+
+    if (!standby_ready())
+        return;
+
+    if (!ready(active())) {
+        swap("active modem down");
+        return;
+    }
+
+    if (signal_poor && (int32_t)(now - signal_timer) >= (int32_t)signal_hold
+            && !poor(standby()))
+        swap("poor signal");
+}
+
+void Failover::bring_up(size_t index, uint32_t now)
+{
+    Modem &modem = *modems[index];
+
+    // Take the next step as soon as the last one finishes
+    if (modem.status() != last_state[index]) {
+        last_state[index] = modem.status();
+        retry_timer[index] = now;
+    }
+
+    if ((int32_t)(now - retry_timer[index]) < 0)
+        return;
+
+    int result = 0;
+    switch (modem.status()) {
+    case State::ready:
+        result = modem.configure(apn);
+        break;
+    case State::registered:
+        result = modem.authenticate(apn);
+        break;
+    case State::online:
+        if (host == nullptr)
+            return;
+
+        result = modem.connect(host, port);
+        break;
+    default:
+        // Busy or already up
+        return;
+    }
+
+    if (result < 0) {
+        LOG_WARN("Failover bring-up failed on modem %lu (%d)\r\n",
+            (unsigned long) index, result);
+    }
+
+    retry_timer[index] = now + kFailoverRetry;
+}
+
+void Failover::swap(const char *reason)
+{
+    Modem &previous = active();
+
+    active_index ^= 1;
+    switch_count += 1;
+    signal_poor = false;
+
+    // Start restoring the failed modem right away
+    retry_timer[active_index ^ 1] = millis();
+
+    LOG_WARN("Failover to modem %lu: %s\r\n",
+        (unsigned long) active_index, reason);
+
+    if (switch_cb)
+        switch_cb(active(), previous, switch_user);
+}
+
+} // namespace gsm
@@ -0,0 +1,166 @@
+/**
+ * @file gnss.cpp
+ * @brief GNSS navigation information parser.
+ * @author Wilkins White
+ * @copyright 2024 Nova Dynamics LLC
+ */
+
+#include <cstring>
+#include <cerrno>
+
+#include "gnss.h"
+
+namespace gsm {
+
+/**
+ * @brief Parse a decimal field as a fixed point integer.
+ *
+ * Digits beyond 'decimals' are truncated.
+ *
+ * @param [in] p - start of the field.
+ * @param [in] end - end of the field.
+ * @param [in] decimals - number of digits to keep after the decimal point.
+ * @return the value multiplied by 10^decimals.
+ */
+static int32_t parse_fixed(const char *p, const char *end, int decimals)
+{
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        ++p;
+    }
+
+    int32_t value = 0;
+    while (p < end && *p >= '0' && *p <= '9')
+        value = (value * 10) + (*p++ - '0');
+
+    int digits = 0;
+    if (p < end && *p == '.') {
+        for (++p; p < end && *p >= '0' && *p <= '9'; ++p) {
+            if (digits < decimals) {
+                value = (value * 10) + (*p - '0');
+                digits += 1;
+            }
+        }
+    }
+
+    for (; digits < decimals; ++digits)
+        value *= 10;
+
+    return (negative) ? -value : value;
+}
+
+/**
+ * @brief Parse a fixed number of digits.
+ *
+ * @param [in,out] p - start of the digits, advanced past them.
+ * @param [in] end - end of the field.
+ * @param [in] count - number of digits.
+ * @return the parsed value.
+ */
+static int parse_digits(const char *&p, const char *end, int count)
+{
+    int value = 0;
+    for (; count > 0 && p < end && *p >= '0' && *p <= '9'; --count)
+        value = (value * 10) + (*p++ - '0');
+
+    return value;
+}
+
+int parse_gnss(const uint8_t *data, size_t size, gnss_t *fix)
+{
+    if (data == nullptr || fix == nullptr)
+        return -EINVAL;
+
+    const char *p = reinterpret_cast<const char*>(data);
+    const char *end = p + size;
+
+    // Strip the line ending
+    while (end > p && (end[-1] == '\r' || end[-1] == '\n'))
+        --end;
+
+    // The run status is always reported
+    if (p == end || *p < '0' || *p > '9')
+        return -EINVAL;
+
+    memset(fix, 0, sizeof(gnss_t));
+
+    // <run>,<fix>,<utc>,<lat>,<lon>,<alt>,<speed>,<course>,<mode>,,<hdop>,
+    // <pdop>,<vdop>,,<gps view>,<gnss used>,<glonass view>,,<cn0>,<hpa>,<vpa>
+    for (int field = 0; p <= end; ++field) {
+        const char *next = static_cast<const char*>(
+                memchr(p, ',', end - p));
+
+        if (next == nullptr)
+            next = end;
+
+        switch (field) {
+        case 0:
+            fix->run = parse_fixed(p, next, 0);
+            break;
+        case 1:
+            fix->fix = parse_fixed(p, next, 0);
+            break;
+        case 2: {
+            // yyyyMMddhhmmss.sss
+            const char *q = p;
+            fix->year = parse_digits(q, next, 4);
+            fix->month = parse_digits(q, next, 2);
+            fix->day = parse_digits(q, next, 2);
+            fix->hour = parse_digits(q, next, 2);
+            fix->minute = parse_digits(q, next, 2);
+            fix->second = parse_digits(q, next, 2);
+            if (q < next && *q == '.')
+                fix->millis = parse_fixed(q, next, 3);
+            break;
+        }
+        case 3:
+            fix->latitude = parse_fixed(p, next, 6);
+            break;
+        case 4:
+            fix->longitude = parse_fixed(p, next, 6);
+            break;
+        case 5:
+            fix->altitude = parse_fixed(p, next, 1);
+            break;
+        case 6:
+            fix->speed = parse_fixed(p, next, 2);
+            break;
+        case 7:
+            fix->course = parse_fixed(p, next, 2);
+            break;
+        case 8:
+            fix->mode = parse_fixed(p, next, 0);
+            break;
+        case 10:
+            fix->hdop = parse_fixed(p, next, 2);
+            break;
+        case 11:
+            fix->pdop = parse_fixed(p, next, 2);
+            break;
+        case 12:
+            fix->vdop = parse_fixed(p, next, 2);
+            break;
+        case 14:
+            fix->gps_view = parse_fixed(p, next, 0);
+            break;
+        case 15:
+            fix->gnss_used = parse_fixed(p, next, 0);
+            break;
+        case 16:
+            fix->glonass_view = parse_fixed(p, next, 0);
+            break;
+        case 18:
+            fix->cn0 = parse_fixed(p, next, 0);
+            break;
+        default:
+            break;
+        }
+
+        p = next + 1;
+    }
+
+    return 0;
+}
+
+} // namespace gsm
@@ -22,8 +22,220 @@ static constexpr uint32_t kPollingInterval = 20;
 /** How long to wait for a 'RDY' response before resetting the modem (ms). */
 static constexpr uint32_t kReadyTimeout = 30000;
 
+/** Host baud rates to probe while detecting the modem's rate. */
+static constexpr uint32_t kBaudRates[] = {
+    115200, 9600, 19200, 38400, 57600, 230400, 460800, 921600,
+};
+
+/** Number of baud rates to probe. */
+static constexpr size_t kBaudRateCount =
+    sizeof(kBaudRates) / sizeof(kBaudRates[0]);
+
+/** How long to wait for the modem to answer each baud rate probe (ms). */
+static constexpr uint32_t kBaudProbeTimeout = 100;
+
+/** Smallest AT+CIPSEND chunk (bytes). */
+static constexpr size_t kChunkMin = 64;
+
+/** AT+CIPSEND chunk size when a connection opens (bytes). */
+static constexpr size_t kChunkStart = 256;
+
+/** Smoothed failure rate above which chunks stop growing (1/256). */
+static constexpr uint16_t kChunkLoss = 16;
+
+/** Largest response body buffered by the modem's HTTP client (bytes). */
+static constexpr size_t kHttpBodyMax = 4096;
+
+/** AT+CNMP mode for GSM only. */
+static constexpr uint8_t kModeGsm = 13;
+
+/** AT+CNMP mode for LTE only. */
+static constexpr uint8_t kModeLte = 38;
+
+/** How often to poll registration while URCs report changes (ms). */
+static constexpr uint32_t kRegistrationInterval = 10000;
+
+/** How often to poll serving cell information (ms). */
+static constexpr uint32_t kCpsiInterval = 30000;
+
+/** Number of consecutive command timeouts before the watchdog trips. */
+static constexpr uint8_t kWatchdogTimeouts = 3;
+
+/** Number of AT+CFUN=1,1 resets before using context_t::hard_reset. */
+static constexpr uint8_t kWatchdogRetries = 1;
+
+/** Deviations added to the smoothed latency for a learned timeout. */
+static constexpr int32_t kTimingDeviations = 4;
+
+/** Responses needed before a learned timeout is used. */
+static constexpr uint8_t kTimingSamples = 4;
+
+/** Most times a class's timeout is doubled after timeouts. */
+static constexpr uint8_t kTimingBackoff = 3;
+
+/** How long to wait for the answer to AT+CMEE? when resynchronizing (ms). */
+static constexpr uint32_t kResyncTimeout = 1000;
+
+/**
+ * @brief Shortest learned timeout of each Timing class (ms).
+ *
+ * Leaves room for the occasional slow response, e.g. while the modem is
+ * busy with the network.
+ */
+static constexpr uint32_t kTimingFloor[] = {
+    0,      // fixed
+    300,    // local
+    500,    // status
+};
+
+static_assert(sizeof(kTimingFloor) / sizeof(kTimingFloor[0])
+    == gsm::kTimingClasses, "Missing Timing floor");
+
 namespace gsm {
 
+/**
+ * @brief Maximum time to wait on a response in each state (ms).
+ *
+ * Longer than any single command timeout of the state so that only a
+ * modem that stops responding across several commands trips the watchdog.
+ *
+ * @param [in] state - device state.
+ * @return silence limit, or 0 if not monitored.
+ */
+static uint32_t silence_limit(State state)
+{
+    switch (state) {
+    case State::reset:
+        return 0; // Covered by kReadyTimeout
+    case State::authenticating:
+        return 180000;
+    case State::handshaking:
+        return 90000;
+    case State::closing:
+        return 45000;
+    default:
+        return 30000;
+    }
+}
+
+/**
+ * @brief Parse the status of a registration report.
+ *
+ * Query responses are "<n>,<stat>[,...]" while unsolicited reports are
+ * "<stat>[,<lac>,<ci>...]", so the second field tells them apart.
+ *
+ * @param [in] data - report following the "+CREG: " prefix.
+ * @param [in] size - length of data.
+ * @param [out] urc - set true if the report was unsolicited.
+ * @return the registration status.
+ */
+static uint8_t parse_registration(const uint8_t *data, size_t size, bool &urc)
+{
+    const char *p = reinterpret_cast<const char*>(data);
+    const char *end = p + size;
+    const char *next = static_cast<const char*>(memchr(p, ',', size));
+
+    urc = (next == nullptr || next + 1 >= end
+        || next[1] < '0' || next[1] > '9');
+
+    return strtoul((urc) ? p : next + 1, nullptr, 10);
+}
+
+/**
+ * @brief Build AT+IFC from the host configuration.
+ *
+ * @param [out] buffer - command without the "AT" prefix.
+ * @param [in] size - size of buffer.
+ * @param [in] baud - host baud rate, or 0 if unknown.
+ * @param [in] flow - true if the host uses RTS/CTS.
+ * @return length of the command, or 0 to skip the step.
+ */
+static int init_flow(char *buffer, size_t size, uint32_t baud, bool flow)
+{
+    (void) baud;
+
+    // AT+IFC=[dce],[dte] - 2 is RTS/CTS, 0 is none
+    const int mode = (flow) ? 2 : 0;
+    return snprintf(buffer, size, "+IFC=%d,%d", mode, mode);
+}
+
+/**
+ * @brief Build AT+IPR from the host configuration.
+ *
+ * @param [out] buffer - command without the "AT" prefix.
+ * @param [in] size - size of buffer.
+ * @param [in] baud - host baud rate, or 0 if unknown.
+ * @param [in] flow - true if the host uses RTS/CTS.
+ * @return length of the command, or 0 to skip the step.
+ */
+static int init_baud(char *buffer, size_t size, uint32_t baud, bool flow)
+{
+    (void) flow;
+
+    if (baud == 0)
+        return 0;
+
+    // AT+IPR=[rate] - fix the baud rate
+    return snprintf(buffer, size, "+IPR=%lu", (unsigned long) baud);
+}
+
+/** One step of the initialization sequence. */
+typedef struct {
+    const char *command; /**< Command without the "AT" prefix. */
+    const char *name; /**< Description for logging. */
+    bool socket; /**< Sockets do not work without it. */
+
+    /** Builds the command from the host configuration if not null. */
+    int (*build)(char *buffer, size_t size, uint32_t baud, bool flow);
+} init_step_t;
+
+/**
+ * @brief Settings applied once after the modem resets.
+ *
+ * Steps are sent in order, each as its own command so that every response
+ * can be verified. Settings are lost when the modem resets.
+ */
+static const init_step_t kInitSequence[] = {
+    {"E0", "disable echo", false, nullptr},
+    {nullptr, "flow control", false, init_flow},
+    {nullptr, "baud rate", false, init_baud},
+    {"+CMEE=1", "numeric error codes", false, nullptr},
+    {"+CREG=2", "network registration URCs", false, nullptr},
+    {"+CEREG=2", "EPS registration URCs", false, nullptr},
+    {"+CIPMUX=0", "single IP connection", true, nullptr},
+    {"+CIPRXGET=1", "manual data receive", true, nullptr},
+    {"+CIPATS=1,1", "auto sending timer", false, nullptr},
+};
+
+/** Number of initialization steps. */
+static constexpr size_t kInitSteps =
+    sizeof(kInitSequence) / sizeof(kInitSequence[0]);
+
+static_assert(kInitSteps <= 16, "Too many initialization steps");
+
+/** Mask of a completed initialization sequence. */
+static constexpr uint16_t kInitComplete = (1u << kInitSteps) - 1;
+
+/**
+ * @brief Times a rejected initialization step is sent again.
+ *
+ * The modem may reject settings while it is still starting up after
+ * 'RDY', so a rejection is retried with a later poll before giving up.
+ */
+static constexpr uint8_t kInitRetries = 3;
+
+/** Return the initialization steps that sockets depend on. */
+static uint16_t init_socket_steps()
+{
+    uint16_t steps = 0;
+    for (size_t i = 0; i < kInitSteps; ++i) {
+        if (kInitSequence[i].socket)
+            steps |= (1u << i);
+    }
+
+    return steps;
+}
+
 #if (NOVAGSM_DEBUG >= NOVAGSM_DEBUG_TRACE)
 static void print_buffer(const uint8_t *data, size_t size)
 {
@@ -78,11 +290,10 @@ Modem::Modem(context_t &context) :
 
 Modem::~Modem()
 {
-    // Free command queue
-    while (cmd_buffer.size() > 0) {
-        delete cmd_buffer.front();
-        cmd_buffer.pop();
-    }
+    clear_commands();
+
+    if (pending)
+        free_pending();
 }
 
 void Modem::set_state_callback(
@@ -106,6 +317,13 @@ void Modem::set_error_callback(
     error_cb_user = user;
 }
 
+void Modem::set_gnss_callback(
+        void (*func)(const gnss_t *fix, void *user), void *user)
+{
+    gnss_cb = func;
+    gnss_cb_user = user;
+}
+
 void Modem::process()
 {
     if (next_state != device_state) {
@@ -116,35 +334,52 @@ void Modem::process()
         device_state = next_state;
         LOG_VERBOSE("State set to %d\r\n", device_state);
         emit_state(device_state);
+
+        if (watchdog_count > 0 && device_state == State::ready) {
+            recovery_ms = millis() - stall_timer;
+            watchdog_count = 0;
+
+            LOG_INFO("Recovered after %lu ms\r\n", (unsigned long) recovery_ms);
+            emit_event(Event::recovered);
+        }
     }
 
+    // Only measure silence while the modem owes us a response
+    if (pending == nullptr && cmd_buffer.size() == 0)
+        silence_timer = millis();
+
     if (pending) {
         // Command pending - wait for response
         int count = read(buffer, kBufferSize);
         if (count > 0) {
+            silence_timer = millis();
             parser.load(buffer, count);
         }
         else if ((int32_t) (millis() - command_timer) > 0) {
             handle_timeout();
         }
     }
-    else if (cmd_buffer.size() > 0) {
-        pending = cmd_buffer.front();
-        cmd_buffer.pop();
-
-#if (NOVAGSM_DEBUG >= NOVAGSM_DEBUG_TRACE)
-        print_buffer(pending->data(), pending->size());
-#endif
-
-        // Send queued command
-        write(pending->data(), pending->size());
+    else {
+        // Collect unsolicited reports between commands
+        int count = read(buffer, kBufferSize);
+        if (count > 0)
+            parser.load(buffer, count);
 
-        command_timer = millis() + pending->timeout();
-    }
-    else if ((int32_t) (millis() - update_timer) > 0) {
-        // Nothing queued - poll the modem
-        update_timer = millis() + kPollingInterval;
-        poll_modem();
+        if (resync_flag) {
+            // Nothing is sent until late responses have been discarded
+            resync();
+        }
+        else if (cmd_buffer.size() > 0) {
+            // Send queued command
+            Command *cmd = cmd_buffer.front();
+            cmd_buffer.pop();
+            send_command(cmd);
+        }
+        else if ((int32_t) (millis() - update_timer) > 0) {
+            // Nothing queued - poll the modem
+            update_timer = millis() + kPollingInterval;
+            poll_modem();
+        }
     }
 
     if (device_state == State::reset) {
@@ -153,17 +388,22 @@ void Modem::process()
         if (reset_timer == 0)
             reset_timer = millis() + kReadyTimeout;
         else if ((int32_t) (millis() - reset_timer) > 0)
-            reset();
+            trip_watchdog();
+    }
+    else if (pending) {
+        // The modem should never go quiet for this long
+        const uint32_t limit = silence_limit(device_state);
+        if (limit && (int32_t) (millis() - silence_timer - limit) > 0) {
+            LOG_WARN("No response for %lu ms\r\n", (unsigned long) limit);
+            trip_watchdog();
+        }
     }
 }
 
 int Modem::reset()
 {
     // Clear any queued commands
-    while (cmd_buffer.size() > 0) {
-        delete cmd_buffer.front();
-        cmd_buffer.pop();
-    }
+    clear_commands();
 
     // AT+CFUN=1,1 - reset phone module
     Command *cmd = new Command(1000, "+CFUN=1,1");
@@ -176,6 +416,13 @@ int Modem::reset()
         return result;
     }
 
+    LOG_VERBOSE("Resetting modem\r\n");
+    reset_device();
+    return 0;
+}
+
+void Modem::reset_device()
+{
     // Reset cached values
     modem_csq = 99;
     modem_cgatt = 0;
@@ -184,6 +431,35 @@ int Modem::reset()
     modem_cereg = 0;
 
     memset(modem_cifsr, '\0', sizeof(modem_cifsr));
+    memset(&modem_gnss, 0, sizeof(modem_gnss));
+    memset(&modem_cpsi, 0, sizeof(modem_cpsi));
+    cpsi_timer = millis();
+
+    // The GNSS engine powers up off
+    gnss_polling = false;
+
+    // Abort file transfer
+    if (fs_step == FsStep::term)
+        emit_event(fs_result);
+    else if (fs_busy())
+        emit_event(Event::fs_error);
+
+    fs_step = FsStep::idle;
+    fs_rx_pending = 0;
+
+    // Abort HTTP client
+    if (http_busy() || http_step == HttpStep::connecting)
+        emit_event(Event::http_error);
+
+    http_step = HttpStep::idle;
+    http_queued = 0;
+    http_rx_pending = 0;
+
+    // The application network is lost with the reset
+    if (pdp_step != PdpStep::inactive)
+        pdp_finish(Event::pdp_inactive);
+
+    parser.expect(0);
 
     // Reset socket
     stop_send();
@@ -191,12 +467,53 @@ int Modem::reset()
 
     modem_rx_available = 0;
     modem_tx_available = 0;
+    modem_rx_pending = 0;
+    ciprxget_flag = false;
 
-    LOG_VERBOSE("Resetting modem\r\n");
     set_state(State::reset);
     probe_flag = false;
     reset_timer = 0;
-    return 0;
+    timeout_count = 0;
+
+    resync_flag = false;
+    resync_marker = false;
+
+    // Settings are lost with the reset
+    init_done = 0;
+    init_queued = 0;
+    init_failed = 0;
+    memset(init_errors, 0, sizeof(init_errors));
+}
+
+void Modem::trip_watchdog()
+{
+    if (watchdog_count == 0)
+        stall_timer = millis();
+
+    if (watchdog_count < 0xff)
+        watchdog_count += 1;
+
+    // The modem may come back at a different baud rate
+    baud_locked = false;
+
+    // The modem is not going to answer the pending command
+    if (pending) {
+        pending->respond(nullptr, 0);
+        free_pending(false);
+    }
+
+    if (watchdog_count > kWatchdogRetries && ctx.hard_reset) {
+        LOG_ERROR("Watchdog - hardware reset\r\n");
+        clear_commands();
+        ctx.hard_reset();
+        reset_device();
+    }
+    else {
+        LOG_WARN("Watchdog - resetting modem\r\n");
+        reset();
+    }
+
+    emit_event(Event::watchdog);
 }
 
 int Modem::configure(const char *apn, uint8_t mode)
@@ -214,9 +531,6 @@ int Modem::configure(const char *apn, uint8_t mode)
     char buffer[64];
     int size = 0;
 
-    // AT+CMEE=1 - enable numeric error codes
-    cmd->add("+CMEE=1");
-
     // AT+CNMP=[mode] - preferred mode selection
     size = snprintf(buffer, sizeof(buffer), "+CNMP=%d", mode);
     if (size < 0)
@@ -239,6 +553,8 @@ int Modem::configure(const char *apn, uint8_t mode)
         return result;
     }
 
+    modem_mode = mode;
+    registration_timer = millis();
     set_state(State::searching);
     return 0;
 }
@@ -269,6 +585,14 @@ int Modem::authenticate(const char *apn, const char *user, const char *pwd)
         break;
     }
 
+    // Socket data would be lost without AT+CIPMUX=0 and AT+CIPRXGET=1
+    const uint16_t socket_steps = init_socket_steps();
+    if (init_failed & socket_steps)
+        return -EIO;
+
+    if ((init_done & socket_steps) != socket_steps)
+        return -EAGAIN;
+
     Command *cmd = new Command(65000);
     if (cmd == nullptr)
         return -ENOMEM;
@@ -279,15 +603,6 @@ int Modem::authenticate(const char *apn, const char *user, const char *pwd)
     // AT+CIPSHUT - reset GPRS context
     cmd->add("+CIPSHUT");
 
-    // AT+CIPMUX=0 - set single IP mode
-    cmd->add("+CIPMUX=0");
-
-    // AT+CIPRXGET=1 - set manual data receive
-    cmd->add("+CIPRXGET=1");
-
-    // AT+CIPATS=1,%d - set auto sending timer
-    cmd->add("+CIPATS=1,1");
-
     // AT+CSTT=[apn],[user],[pwd] - set apn/user/password for GPRS context
     if (user == nullptr) {
         size = snprintf(buffer, sizeof(buffer),
@@ -356,6 +671,10 @@ int Modem::connect(const char *host, unsigned int port)
         break;
     }
 
+    // Nothing left over from the last connection may go out on this one
+    stop_send();
+    stop_receive();
+
     Command *cmd = new Command(75000);
     if (cmd == nullptr)
         return -ENOMEM;
@@ -408,298 +727,1697 @@ int Modem::close(bool quick)
     return result;
 }
 
-int Modem::receive(void *data, size_t size)
+int Modem::fs_write(
+        Directory dir,
+        const char *name,
+        const void *data,
+        size_t size,
+        bool append)
 {
-    if (!connected())
-        return -ENOTCONN;
+    if (data == nullptr)
+        return -EINVAL;
 
-    rx_buffer = static_cast<uint8_t*>(data);
-    rx_size = size;
-    rx_index = 0;
-    return 0;
-}
+    int result = fs_start(FsStep::write, dir, name);
+    if (result)
+        return result;
 
-void Modem::stop_receive()
-{
-    const bool stopped = rx_busy();
-    rx_buffer = nullptr;
-    rx_size = 0;
-    rx_index = 0;
+    fs_tx_buffer = static_cast<const uint8_t*>(data);
+    fs_size = size;
+    fs_offset = 0;
+    fs_append = append;
 
-    if (stopped) {
-        LOG_WARN("Receive interrupted\r\n");
-        emit_event(Event::rx_complete);
-    }
+    LOG_INFO("Writing %s\r\n", fs_name);
+    return fs_next();
 }
 
-int Modem::send(const void *data, size_t size)
+int Modem::fs_read(
+        Directory dir,
+        const char *name,
+        void *data,
+        size_t size,
+        size_t offset)
 {
-    if (!connected())
-        return -ENOTCONN;
+    if (data == nullptr)
+        return -EINVAL;
 
-    tx_buffer = static_cast<const uint8_t*>(data);
-    tx_size = size;
-    tx_index = 0;
-    return 0;
-}
+    int result = fs_start(FsStep::read, dir, name);
+    if (result)
+        return result;
 
-void Modem::stop_send()
-{
-    const bool stopped = tx_busy();
-    tx_buffer = nullptr;
-    tx_size = 0;
-    tx_index = 0;
+    fs_rx_buffer = static_cast<uint8_t*>(data);
+    fs_size = size;
+    fs_offset = offset;
 
-    if (stopped) {
-        LOG_WARN("Send interrupted\r\n");
-        emit_event(Event::tx_complete);
-    }
+    LOG_INFO("Reading %s\r\n", fs_name);
+    return fs_next();
 }
 
-void Modem::set_state(State state)
+int Modem::http_open(const char *url, const char *ca, bool insecure)
 {
-    next_state = state;
-}
+    if (url == nullptr)
+        return -EINVAL;
 
-void Modem::free_pending()
-{
-    if (pending == nullptr) {
-        LOG_WARN("Double free\r\n");
-        return;
+    // Verification may only be skipped on request
+    const bool tls = (strncmp(url, "https:", 6) == 0);
+    if (tls && ca == nullptr && !insecure)
+        return -EINVAL;
+
+    switch (next_state) {
+    // Invalid state, return error
+    case State::reset:
+        return -ENODEV;
+    case State::ready:
+    case State::error:
+    case State::searching:
+        return -ENETUNREACH;
+
+    // Continue
+    default:
+        break;
     }
 
-    delete pending;
-    pending = nullptr;
-}
+    if (http_step != HttpStep::idle)
+        return -EALREADY;
 
-int Modem::push_command(Command *cmd)
-{
-    if (cmd == nullptr)
+    char buffer[128];
+    int size = snprintf(buffer, sizeof(buffer), "+SHCONF=\"URL\",\"%s\"", url);
+    if (size < 0 || size >= static_cast<int>(sizeof(buffer)))
         return -EINVAL;
 
-    if (cmd->size() >= kBufferSize)
-        return -EMSGSIZE;
+    Command *cmd = new Command(5000);
+    if (cmd == nullptr)
+        return -ENOMEM;
 
-    cmd_buffer.push(cmd);
-    return 0;
-}
+    // AT+SHCONF="URL",[url] - set server url
+    cmd->add(buffer, size);
 
-int Modem::poll_modem()
-{
-    Command *cmd = nullptr;
+    // AT+SHCONF="BODYLEN",[size] - set maximum response body length
+    size = snprintf(buffer, sizeof(buffer),
+            "+SHCONF=\"BODYLEN\",%u", (unsigned int) kHttpBodyMax);
 
-    switch (status()) {
-    case State::reset:
-    case State::ready:
-        cmd = new Command(1000); // AT
-        if (cmd != nullptr && probe_flag) {
-            update_timer = millis() + 1000;
-            probe_flag = false;
+    cmd->add(buffer, size);
 
-            // AT+CFUN? - power status
-            cmd->add("+CFUN?");
-            // AT+CPIN? - SIM status
-            cmd->add("+CPIN?");
+    // AT+SHCONF="HEADERLEN",350 - set maximum response header length
+    cmd->add("+SHCONF=\"HEADERLEN\",350");
+
+    if (tls) {
+        // AT+CSSLCFG="sslversion",1,3 - use TLS 1.2
+        cmd->add("+CSSLCFG=\"sslversion\",1,3");
+
+        if (ca != nullptr) {
+            // AT+CSSLCFG="convert",2,[ca] - load the root certificate
+            size = snprintf(buffer, sizeof(buffer),
+                    "+CSSLCFG=\"convert\",2,\"%s\"", ca);
+            if (size < 0 || size >= static_cast<int>(sizeof(buffer))) {
+                delete cmd;
+                return -EINVAL;
+            }
+
+            cmd->add(buffer, size);
+
+            // AT+SHSSL=1,[ca] - verify the server against it
+            size = snprintf(buffer, sizeof(buffer),
+                    "+SHSSL=1,\"%s\"", ca);
+            cmd->add(buffer, size);
         }
-        break;
-    case State::searching:
-    case State::registered:
-    case State::online:
-        cmd = new Command(10000);
-        if (cmd != nullptr) {
-            // AT+CSQ - signal quality report
-            cmd->add("+CSQ");
-            // AT+CREG? - network registration status
-            cmd->add("+CREG?");
-            // AT+CGREG? - GPRS registration status
-            cmd->add("+CGREG?");
-            // AT+CEREG? - EPS registration status
-            cmd->add("+CEREG?");
-            // AT+CGATT? - GPRS service status
-            cmd->add("+CGATT?");
+        else {
+            // AT+SHSSL=1,"" - enable TLS without a root certificate
+            LOG_WARN("TLS server not verified\r\n");
+            cmd->add("+SHSSL=1,\"\"");
         }
-        break;
-    case State::authenticating:
-        // AT+CIFSR - get local IP address
-        cmd = new Command(1000, "+CIFSR");
-        cifsr_flag = true;
-        break;
-    case State::open:
-        return poll_socket();
-    case State::handshaking:
-    case State::error:
-    case State::closing:
-        return 0;
     }
 
-    if (cmd == nullptr)
-        return -ENOMEM;
+    int result = push_http(cmd);
+    if (result) {
+        delete cmd;
+        return result;
+    }
+
+    // AT+SHCONN - connect to the server
+    cmd = new Command(60000, "+SHCONN");
+    if (cmd == nullptr)
+        return -ENOMEM;
+
+    result = push_http(cmd);
+    if (result) {
+        delete cmd;
+        return result;
+    }
+
+    LOG_INFO("Connecting HTTP client\r\n");
+    http_step = HttpStep::connecting;
+    return 0;
+}
+
+int Modem::http_get(const char *path, void *data, size_t size, size_t offset)
+{
+    if (path == nullptr || data == nullptr)
+        return -EINVAL;
+
+    if (strlen(path) >= sizeof(http_path))
+        return -EINVAL;
+
+    if (http_busy())
+        return -EALREADY;
+
+    if (http_step != HttpStep::connected)
+        return -ENOTCONN;
+
+    strcpy(http_path, path);
+    http_buffer = static_cast<uint8_t*>(data);
+    http_size = size;
+    http_index = 0;
+    http_offset = offset;
+
+    if (size == 0) {
+        emit_event(Event::http_complete);
+        return 0;
+    }
+
+    LOG_INFO("Downloading %s\r\n", http_path);
+    return http_request();
+}
+
+int Modem::http_close()
+{
+    if (http_step == HttpStep::idle || http_step == HttpStep::closing)
+        return -ENOTCONN;
+
+    // AT+SHDISC - disconnect from the server
+    Command *cmd = new Command(kDefaultTimeout, "+SHDISC");
+    if (cmd == nullptr)
+        return -ENOMEM;
+
+    int result = push_http(cmd);
+    if (result) {
+        delete cmd;
+        return result;
+    }
+
+    if (http_busy()) {
+        LOG_WARN("Download interrupted\r\n");
+        emit_event(Event::http_error);
+    }
+
+    LOG_INFO("Closing HTTP client\r\n");
+    http_step = HttpStep::closing;
+    return 0;
+}
+
+int Modem::gnss_start(uint32_t interval, bool urc)
+{
+    if (status() == State::reset)
+        return -ENODEV;
+
+    Command *cmd = new Command();
+    if (cmd == nullptr)
+        return -ENOMEM;
+
+    // AT+CGNSPWR=1 - power on the GNSS engine
+    cmd->add("+CGNSPWR=1");
+
+    if (urc) {
+        // The engine produces one fix per second
+        uint32_t count = interval / 1000;
+        if (count < 1)
+            count = 1;
+        else if (count > 255)
+            count = 255;
+
+        char buffer[64];
+        int size = snprintf(buffer, sizeof(buffer),
+                "+CGNSURC=%lu", (unsigned long) count);
+
+        if (size < 0)
+            return size;
+
+        // AT+CGNSURC=[count] - report every 'count' fixes
+        cmd->add(buffer, size);
+    }
+    else {
+        // AT+CGNSURC=0 - disable unsolicited reports
+        cmd->add("+CGNSURC=0");
+    }
+
+    int result = push_command(cmd);
+    if (result) {
+        delete cmd;
+        return result;
+    }
+
+    LOG_INFO("Starting GNSS\r\n");
+    gnss_polling = !urc;
+    gnss_interval = interval;
+    gnss_timer = millis() + interval;
+    return 0;
+}
+
+int Modem::pdp_activate(const char *apn)
+{
+    if (apn == nullptr)
+        return -EINVAL;
+
+    if (status() == State::reset)
+        return -ENODEV;
+
+    if (status() < State::registered)
+        return -ENETUNREACH;
+
+    if (pdp_step != PdpStep::inactive)
+        return -EALREADY;
+
+    char buffer[128];
+    int size = snprintf(buffer, sizeof(buffer), "+CNACT=1,\"%s\"", apn);
+    if (size < 0)
+        return size;
+
+    if (size >= (int) sizeof(buffer))
+        return -EINVAL;
+
+    // AT+CNACT=1,[apn] - activate the application network
+    Command *cmd = new Command();
+    if (cmd == nullptr)
+        return -ENOMEM;
+
+    cmd->add(buffer, size);
+    cmd->set_tag(Tag::pdp);
+
+    int result = push_command(cmd);
+    if (result) {
+        delete cmd;
+        return result;
+    }
+
+    LOG_INFO("Activating application network\r\n");
+    pdp_step = PdpStep::activating;
+    return 0;
+}
+
+int Modem::pdp_deactivate()
+{
+    if (pdp_step != PdpStep::active)
+        return -ENOTCONN;
+
+    // AT+CNACT=0 - deactivate the application network
+    Command *cmd = new Command(kDefaultTimeout, "+CNACT=0");
+    if (cmd == nullptr)
+        return -ENOMEM;
+
+    cmd->set_tag(Tag::pdp);
+
+    int result = push_command(cmd);
+    if (result) {
+        delete cmd;
+        return result;
+    }
+
+    LOG_INFO("Deactivating application network\r\n");
+    pdp_step = PdpStep::deactivating;
+    return 0;
+}
+
+int Modem::gnss_stop()
+{
+    if (status() == State::reset)
+        return -ENODEV;
+
+    Command *cmd = new Command();
+    if (cmd == nullptr)
+        return -ENOMEM;
+
+    // AT+CGNSURC=0 - disable unsolicited reports
+    cmd->add("+CGNSURC=0");
+
+    // AT+CGNSPWR=0 - power off the GNSS engine
+    cmd->add("+CGNSPWR=0");
+
+    int result = push_command(cmd);
+    if (result) {
+        delete cmd;
+        return result;
+    }
+
+    LOG_INFO("Stopping GNSS\r\n");
+    gnss_polling = false;
+    return 0;
+}
+
+int Modem::command(
+        const char *data, response_cb_t func, void *user, uint32_t timeout)
+{
+    if (data == nullptr)
+        return -EINVAL;
+
+    if (status() == State::reset)
+        return -ENODEV;
+
+    Command *cmd = new Command(timeout, data);
+    if (cmd == nullptr)
+        return -ENOMEM;
+
+    cmd->set_tag(Tag::user);
+    cmd->set_response_callback(func, user);
+
+    int result = push_command(cmd);
+    if (result) {
+        delete cmd;
+        return result;
+    }
+
+    return 0;
+}
+
+int Modem::receive(void *data, size_t size)
+{
+    if (!connected())
+        return -ENOTCONN;
+
+    rx_buffer = static_cast<uint8_t*>(data);
+    rx_size = size;
+    rx_index = 0;
+    return 0;
+}
+
+void Modem::stop_receive()
+{
+    const bool stopped = rx_busy();
+    rx_buffer = nullptr;
+    rx_size = 0;
+    rx_index = 0;
+
+    if (stopped) {
+        LOG_WARN("Receive interrupted\r\n");
+        emit_event(Event::rx_complete);
+    }
+}
+
+int Modem::send(const void *data, size_t size, Priority priority)
+{
+    if (!connected())
+        return -ENOTCONN;
+
+    tx_buffer = static_cast<const uint8_t*>(data);
+    tx_size = size;
+    tx_index = 0;
+    tx_priority = priority;
+    tx_hold = false;
+    tx_hold_expired = false;
+    return 0;
+}
+
+void Modem::set_bulk_threshold(
+        int16_t rsrp, int16_t sinr, uint32_t max_defer)
+{
+    bulk_rsrp = rsrp;
+    bulk_sinr = sinr;
+    bulk_max_defer = max_defer;
+}
+
+int Modem::set_duplex_share(uint8_t rx, uint8_t tx)
+{
+    if (rx == 0 || tx == 0)
+        return -EINVAL;
+
+    rx_share = rx;
+    tx_share = tx;
+    return 0;
+}
+
+void Modem::set_adaptive_timeouts(bool enable)
+{
+    adaptive_timeouts = enable;
+}
+
+void Modem::stop_send()
+{
+    const bool stopped = tx_busy();
+    tx_buffer = nullptr;
+    tx_size = 0;
+    tx_index = 0;
+    tx_hold = false;
+    tx_hold_expired = false;
+
+    if (stopped) {
+        LOG_WARN("Send interrupted\r\n");
+        emit_event(Event::tx_complete);
+    }
+}
+
+void Modem::set_state(State state)
+{
+    next_state = state;
+}
+
+void Modem::free_pending(bool answered)
+{
+    if (pending == nullptr) {
+        LOG_WARN("Double free\r\n");
+        return;
+    }
+
+    if (answered)
+        sample_latency();
+
+    delete pending;
+    pending = nullptr;
+}
+
+void Modem::clear_commands()
+{
+    while (cmd_buffer.size() > 0) {
+        Command *cmd = cmd_buffer.front();
+        cmd_buffer.pop();
+
+        cmd->respond(nullptr, 0);
+        delete cmd;
+    }
+}
+
+void Modem::send_command(Command *cmd)
+{
+    pending = cmd;
+
+#if (NOVAGSM_DEBUG >= NOVAGSM_DEBUG_TRACE)
+    print_buffer(pending->data(), pending->size());
+#endif
+
+    write(pending->data(), pending->size());
+
+    command_start = millis();
+    command_timer = command_start + pending_timeout();
+}
+
+uint32_t Modem::pending_timeout() const
+{
+    const uint32_t limit = pending->timeout();
+    if (!adaptive_timeouts)
+        return limit;
+
+    const uint32_t learned = learned_timeout(pending->timing());
+    if (learned == 0)
+        return limit;
+
+    return std::min(learned, limit);
+}
+
+uint32_t Modem::learned_timeout(Timing timing) const
+{
+    const size_t index = static_cast<size_t>(timing);
+    if (timing == Timing::fixed || index >= kTimingClasses)
+        return 0;
+
+    const Latency &l = latency[index];
+    if (l.samples < kTimingSamples)
+        return 0;
+
+    uint32_t timeout = (l.srtt + kTimingDeviations * l.rttvar) >> 3;
+    timeout = std::max(timeout, kTimingFloor[index]);
+    return timeout << l.backoff;
+}
+
+void Modem::sample_latency()
+{
+    // A late response to a timed out command may finish this one early
+    if (skip_sample) {
+        skip_sample = false;
+        return;
+    }
+
+    const Timing timing = pending->timing();
+    if (timing == Timing::fixed)
+        return;
+
+    Latency &l = latency[static_cast<size_t>(timing)];
+    const int32_t sample = (int32_t)(millis() - command_start) << 3;
+
+    // Smoothed as in RFC 6298 with gains of 1/8 and 1/4
+    if (l.samples == 0) {
+        l.srtt = sample;
+        l.rttvar = sample / 2;
+    }
+    else {
+        const int32_t error = sample - l.srtt;
+        l.srtt += error / 8;
+        l.rttvar += ((error < 0 ? -error : error) - l.rttvar) / 4;
+    }
+
+    if (l.samples < 0xff)
+        l.samples += 1;
+
+    l.backoff = 0;
+}
+
+int Modem::push_command(Command *cmd)
+{
+    if (cmd == nullptr)
+        return -EINVAL;
+
+    if (cmd->size() >= kBufferSize)
+        return -EMSGSIZE;
+
+    cmd_buffer.push(cmd);
+    return 0;
+}
+
+int Modem::poll_modem()
+{
+    Command *cmd = nullptr;
+
+    // Apply the initialization sequence once the modem responds
+    if (status() != State::reset && init_queued == 0
+            && init_done != kInitComplete) {
+        return push_init();
+    }
+
+    switch (status()) {
+    case State::reset:
+    case State::ready:
+        // AT - short probes while detecting the baud rate
+        cmd = new Command((autobaud()) ? kBaudProbeTimeout : 1000);
+        if (cmd != nullptr && probe_flag) {
+            update_timer = millis() + 1000;
+            probe_flag = false;
+
+            // AT+CFUN? - power status
+            cmd->add("+CFUN?");
+            // AT+CPIN? - SIM status
+            cmd->add("+CPIN?");
+
+            // AT+CGNSINF - GNSS navigation information
+            if (gnss_due())
+                cmd->add("+CGNSINF");
+        }
+        break;
+    case State::searching:
+    case State::registered:
+    case State::online: {
+        // Registration changes are reported by URCs, so only poll slowly
+        const bool registration = registration_due();
+        const bool fix = gnss_due();
+        if (!registration && !fix)
+            return 0;
+
+        cmd = new Command(10000);
+        if (cmd != nullptr)
+            cmd->set_timing(Timing::status);
+
+        if (cmd != nullptr && registration) {
+            // AT+CSQ - signal quality report
+            cmd->add("+CSQ");
+
+            if (modem_mode != kModeLte) {
+                // AT+CREG? - network registration status
+                cmd->add("+CREG?");
+                // AT+CGREG? - GPRS registration status
+                cmd->add("+CGREG?");
+            }
+
+            if (modem_mode != kModeGsm) {
+                // AT+CEREG? - EPS registration status
+                cmd->add("+CEREG?");
+            }
+
+            // AT+CGATT? - GPRS service status
+            cmd->add("+CGATT?");
+
+            // AT+CPSI? - serving cell information
+            if (status() != State::searching && cpsi_due())
+                cmd->add("+CPSI?");
+        }
+
+        // AT+CGNSINF - GNSS navigation information
+        if (cmd != nullptr && fix)
+            cmd->add("+CGNSINF");
+
+        break;
+    }
+    case State::authenticating:
+        // AT+CIFSR - get local IP address
+        cmd = new Command(1000, "+CIFSR");
+        if (cmd != nullptr)
+            cmd->set_timing(Timing::local);
+
+        cifsr_flag = true;
+        break;
+    case State::open:
+        return poll_socket();
+    case State::handshaking:
+    case State::error:
+    case State::closing:
+        return 0;
+    }
+
+    if (cmd == nullptr)
+        return -ENOMEM;
+
+    int result = push_command(cmd);
+    if (result != 0) {
+        delete cmd;
+        return result;
+    }
+
+    return 0;
+}
+
+int Modem::poll_socket()
+{
+    const int rx_requested = (rx_buffer) ? (rx_size - rx_index) : 0;
+    const int tx_requested = (tx_buffer) ? (tx_size - tx_index) : 0;
+
+    const bool rx_go = rx_requested && modem_rx_available;
+    const bool tx_go = tx_requested && modem_tx_available && tx_ready();
+
+    // Weighted fair queuing - serve the direction that has moved the fewest
+    // bytes for its share. An idle direction does not bank credit.
+    bool rx_turn = rx_go;
+    if (rx_go && tx_go) {
+        rx_turn = (int32_t)(rx_vtime - tx_vtime) <= 0;
+    }
+    else {
+        rx_vtime = 0;
+        tx_vtime = 0;
+    }
+
+    if (rx_turn) {
+        int result = socket_receive(rx_requested);
+        if(result < 0)
+            return result;
+
+        if (tx_go)
+            rx_vtime += (result << 8) / rx_share;
+    }
+    else if (tx_go) {
+        int result = socket_send(tx_buffer + tx_index, tx_requested);
+        if (result < 0)
+            return result;
+
+        if (rx_go)
+            tx_vtime += (result << 8) / tx_share;
+
+        cipsend_flag = true;
+    }
+    else {
+        Command *cmd = new Command(1000);
+        if (cmd == nullptr)
+            return -ENOMEM;
+
+        cmd->set_timing(Timing::local);
+
+        // AT+CSQ - signal quality report
+        cmd->add("+CSQ");
+        // AT+CIPRXGET=4 - query socket unread bytes
+        cmd->add("+CIPRXGET=4");
+        // AT+CIPSEND? - query available size of tx buffer
+        cmd->add("+CIPSEND?");
+
+        // AT+CPSI? - serving cell information
+        if (cpsi_due())
+            cmd->add("+CPSI?");
+
+        // AT+CGNSINF - GNSS navigation information
+        if (gnss_due())
+            cmd->add("+CGNSINF");
+
+        int result = push_command(cmd);
+        if (result != 0) {
+            delete cmd;
+            return result;
+        }
+    }
+
+    return 0;
+}
+
+int Modem::socket_receive(size_t size)
+{
+    const size_t available = std::min(modem_rx_available, kSocketMax);
+    if (size > available)
+        size = available;
+
+    if (size <= 0)
+        return 0;
+
+    Command *cmd = new Command();
+    if (cmd == nullptr)
+        return -ENOMEM;
+
+    char buffer[64];
+    int len = snprintf(buffer, sizeof(buffer), "+CIPRXGET=2,%d", size);
+    if (len < 0)
+        return len;
+
+    // AT+CIPRXGET=2,[size] - read 'size' bytes from the socket
+    cmd->add(buffer, len);
+
+    int result = push_command(cmd);
+    if (result) {
+        delete cmd;
+        return result;
+    }
+
+    LOG_VERBOSE("RTR %d bytes (%d)\r\n", size, modem_rx_available);
+    return size;
+}
+
+int Modem::socket_send(const uint8_t *data, size_t size)
+{
+    const size_t available = std::min(modem_tx_available, chunk_size);
+    if (size > available)
+        size = available;
+
+    if (size > 0) {
+        Command *cmd = new Command(1000);
+        if (cmd == nullptr)
+            return -ENOMEM;
+
+        char buffer[64];
+        int len = snprintf(buffer, sizeof(buffer), "+CIPSEND=%d", size);
+        if (len < 0)
+            return len;
+
+        // AT+CIPSEND=[size] - indicate that data is about to be sent
+        cmd->add(buffer, len);
+
+        int result = push_command(cmd);
+        if (result) {
+            delete cmd;
+            return result;
+        }
+
+        // Send the data
+        std::vector<uint8_t> payload(size);
+        memcpy(payload.data(), data, size);
+
+        cmd = new Command(10000, payload);
+        if (cmd == nullptr)
+            return -ENOMEM;
+
+        result = push_command(cmd);
+        if (result) {
+            delete cmd;
+            return result;
+        }
+
+        // Spend the credit until 'SEND OK' or the next AT+CIPSEND?
+        modem_tx_available -= size;
+    }
+
+    LOG_VERBOSE("RTS %d bytes (%d)\r\n", size, (tx_size - tx_index));
+    return size;
+}
+
+void Modem::adapt_chunk(bool ok)
+{
+    // Moving average with a weight of 1/8
+    chunk_loss = chunk_loss - (chunk_loss >> 3) + ((ok) ? 0 : 32);
+
+    if (!ok) {
+        chunk_size = std::max(kChunkMin, chunk_size / 2);
+        LOG_VERBOSE("Chunk size %d (failed)\r\n", chunk_size);
+        return;
+    }
+
+    // 'SEND OK' waits for the server's ACK, so its latency is mostly round
+    // trip time and says little about the chunk size
+    if (chunk_loss < kChunkLoss)
+        chunk_size = std::min(kSocketMax, chunk_size + (chunk_size / 4));
+
+    LOG_VERBOSE("Chunk size %d\r\n", chunk_size);
+}
+
+int Modem::fs_start(FsStep step, Directory dir, const char *name)
+{
+    if (name == nullptr)
+        return -EINVAL;
+
+    if (strlen(name) >= sizeof(fs_name))
+        return -ENAMETOOLONG;
+
+    if (status() == State::reset)
+        return -ENODEV;
+
+    if (fs_step != FsStep::idle)
+        return -EALREADY;
+
+    // AT+CFSINIT - allocate the filesystem buffer
+    Command *cmd = new Command(kDefaultTimeout, "+CFSINIT");
+    if (cmd == nullptr)
+        return -ENOMEM;
+
+    cmd->set_tag(Tag::filesystem);
 
     int result = push_command(cmd);
-    if (result != 0) {
+    if (result) {
+        delete cmd;
+        return result;
+    }
+
+    strcpy(fs_name, name);
+    fs_dir = dir;
+    fs_op = step;
+    fs_step = FsStep::init;
+    fs_index = 0;
+    fs_chunk = 0;
+    return 0;
+}
+
+int Modem::fs_next()
+{
+    const size_t remaining = fs_size - fs_index;
+    if (remaining == 0) {
+        fs_finish(Event::fs_complete);
+        return 0;
+    }
+
+    const size_t size = std::min(remaining, kSocketMax);
+
+    char buffer[96];
+    int len = 0;
+
+    if (fs_op == FsStep::write) {
+        // AT+CFSWFILE=[index],[name],[mode],[size],[time] - write to a file
+        const int mode = (fs_append || fs_index > 0) ? 1 : 0;
+        len = snprintf(buffer, sizeof(buffer),
+                "+CFSWFILE=%d,\"%s\",%d,%u,10000",
+                static_cast<int>(fs_dir), fs_name, mode,
+                (unsigned int) size);
+    }
+    else {
+        // AT+CFSRFILE=[index],[name],[mode],[size],[position] - read a file
+        len = snprintf(buffer, sizeof(buffer),
+                "+CFSRFILE=%d,\"%s\",1,%u,%u",
+                static_cast<int>(fs_dir), fs_name,
+                (unsigned int) size, (unsigned int) (fs_offset + fs_index));
+    }
+
+    if (len < 0)
+        return len;
+
+    Command *cmd = new Command(10000);
+    if (cmd == nullptr)
+        return -ENOMEM;
+
+    cmd->add(buffer, len);
+    cmd->set_tag(Tag::filesystem);
+
+    int result = push_command(cmd);
+    if (result) {
+        delete cmd;
+        return result;
+    }
+
+    // Writes know their chunk size up front, reads count received bytes
+    fs_chunk = (fs_op == FsStep::write) ? size : 0;
+    return 0;
+}
+
+void Modem::fs_finish(Event event)
+{
+    fs_step = FsStep::term;
+    fs_result = event;
+    fs_rx_pending = 0;
+
+    if (event == Event::fs_complete)
+        LOG_INFO("Transferred %d bytes\r\n", fs_index);
+    else
+        LOG_WARN("File transfer failed\r\n");
+
+    // AT+CFSTERM - free the filesystem buffer
+    Command *cmd = new Command(kDefaultTimeout, "+CFSTERM");
+    if (cmd == nullptr) {
+        fs_done();
+        return;
+    }
+
+    cmd->set_tag(Tag::filesystem);
+    if (push_command(cmd) != 0) {
+        delete cmd;
+        fs_done();
+    }
+}
+
+void Modem::fs_done()
+{
+    fs_step = FsStep::idle;
+    emit_event(fs_result);
+}
+
+int Modem::push_http(Command *cmd)
+{
+    if (cmd == nullptr)
+        return -EINVAL;
+
+    cmd->set_tag(Tag::http);
+
+    int result = push_command(cmd);
+    if (result == 0)
+        http_queued += 1;
+
+    return result;
+}
+
+int Modem::http_request()
+{
+    const size_t start = http_offset + http_index;
+    http_range = std::min(http_size - http_index, kHttpBodyMax);
+    http_length = 0;
+    http_pos = 0;
+
+    char buffer[96];
+    int len = snprintf(buffer, sizeof(buffer),
+            "+SHAHEAD=\"Range\",\"bytes=%lu-%lu\"",
+            (unsigned long) start, (unsigned long) (start + http_range - 1));
+
+    if (len < 0)
+        return len;
+
+    // AT+SHCHEAD - clear request headers
+    Command *cmd = new Command(kDefaultTimeout, "+SHCHEAD");
+    if (cmd == nullptr)
+        return -ENOMEM;
+
+    // AT+SHAHEAD="Range",[range] - request part of the resource
+    cmd->add(buffer, len);
+
+    int result = push_http(cmd);
+    if (result) {
+        delete cmd;
+        return result;
+    }
+
+    len = snprintf(buffer, sizeof(buffer), "+SHREQ=\"%s\",1", http_path);
+    if (len < 0)
+        return len;
+
+    // AT+SHREQ=[path],1 - send a GET request
+    cmd = new Command(60000);
+    if (cmd == nullptr)
+        return -ENOMEM;
+
+    cmd->add(buffer, len);
+
+    result = push_http(cmd);
+    if (result) {
+        delete cmd;
+        return result;
+    }
+
+    http_step = HttpStep::requesting;
+    return 0;
+}
+
+int Modem::http_next()
+{
+    const size_t size = std::min(std::min(
+            http_length - http_pos, http_size - http_index), kSocketMax);
+
+    char buffer[64];
+    int len = snprintf(buffer, sizeof(buffer), "+SHREAD=%lu,%lu",
+            (unsigned long) http_pos, (unsigned long) size);
+
+    if (len < 0)
+        return len;
+
+    // AT+SHREAD=[position],[size] - read the response body
+    Command *cmd = new Command(10000);
+    if (cmd == nullptr)
+        return -ENOMEM;
+
+    cmd->add(buffer, len);
+
+    int result = push_http(cmd);
+    if (result) {
         delete cmd;
         return result;
     }
 
-    return 0;
+    http_step = HttpStep::reading;
+    return 0;
+}
+
+void Modem::http_finish(Event event)
+{
+    http_step = HttpStep::connected;
+    http_rx_pending = 0;
+
+    if (event == Event::http_complete)
+        LOG_INFO("Downloaded %d bytes\r\n", http_index);
+    else
+        LOG_WARN("Download failed at %d bytes\r\n", http_index);
+
+    emit_event(event);
+}
+
+bool Modem::gnss_due()
+{
+    if (!gnss_polling)
+        return false;
+
+    if ((int32_t) (millis() - gnss_timer) < 0)
+        return false;
+
+    gnss_timer = millis() + gnss_interval;
+    return true;
+}
+
+void Modem::parse_gnss_fix(uint8_t *start, size_t size)
+{
+    gnss_t fix;
+    if (parse_gnss(start, size, &fix) != 0) {
+        LOG_WARN("Invalid GNSS report\r\n");
+        return;
+    }
+
+    modem_gnss = fix;
+    emit_gnss(&modem_gnss);
+}
+
+void Modem::next_baud()
+{
+    baud_index = (baud_index + 1) % kBaudRateCount;
+    baud_rate = kBaudRates[baud_index];
+
+    LOG_VERBOSE("Probing at %lu baud\r\n", (unsigned long) baud_rate);
+    ctx.set_baud(baud_rate);
+}
+
+int Modem::push_init()
+{
+    // Fix the modem to the rate found by detection, if any
+    const uint32_t baud = (baud_rate) ? baud_rate : ctx.baud;
+
+    for (size_t i = 0; i < kInitSteps; ++i) {
+        const uint16_t step = (1u << i);
+        if (init_done & step)
+            continue;
+
+        const init_step_t &init = kInitSequence[i];
+
+        char buffer[32];
+        int len = 0;
+        if (init.build) {
+            len = init.build(buffer, sizeof(buffer), baud, ctx.flow);
+            if (len < 0 || len >= static_cast<int>(sizeof(buffer)))
+                return -EINVAL;
+
+            // Nothing to apply for this host
+            if (len == 0) {
+                init_done |= step;
+                continue;
+            }
+        }
+
+        Command *cmd = new Command(kDefaultTimeout);
+        if (cmd == nullptr)
+            return -ENOMEM;
+
+        if (init.build)
+            cmd->add(buffer, len);
+        else
+            cmd->add(init.command);
+
+        cmd->set_tag(Tag::init);
+        cmd->set_timing(Timing::local);
+
+        int result = push_command(cmd);
+        if (result) {
+            delete cmd;
+            return result;
+        }
+
+        init_queued |= step;
+    }
+
+    LOG_VERBOSE("Initializing modem\r\n");
+    return 0;
+}
+
+bool Modem::registration_due()
+{
+    if ((int32_t) (millis() - registration_timer) < 0)
+        return false;
+
+    registration_timer = millis() + kRegistrationInterval;
+    return true;
+}
+
+void Modem::handle_registration()
+{
+    // Refresh the service status along with the next poll
+    LOG_VERBOSE("Registration changed\r\n");
+    registration_timer = millis();
+}
+
+bool Modem::cpsi_due()
+{
+    if ((int32_t) (millis() - cpsi_timer) < 0)
+        return false;
+
+    cpsi_timer = millis() + kCpsiInterval;
+    return true;
+}
+
+void Modem::parse_cpsi(uint8_t *start, size_t size)
+{
+    cpsi_t info = {};
+
+    // Only LTE cells report signal metrics
+    if (size >= 3 && memcmp(start, "LTE", 3) == 0) {
+        char *p = reinterpret_cast<char*>(start);
+        char *end = p + size;
+        int field = 0;
+
+        for (; p < end; ++field) {
+            char *next = static_cast<char*>(memchr(p, ',', end - p));
+            if (next == nullptr)
+                next = end;
+
+            switch (field) {
+            case 10:
+                info.rsrq = strtol(p, nullptr, 10);
+                break;
+            case 11:
+                info.rsrp = strtol(p, nullptr, 10);
+                break;
+            case 12:
+                info.rssi = strtol(p, nullptr, 10);
+                break;
+            case 13:
+                info.sinr = strtol(p, nullptr, 10);
+                break;
+            default:
+                break;
+            }
+
+            p = next + 1;
+        }
+
+        info.lte = (field > 13);
+    }
+
+    modem_cpsi = info;
+}
+
+bool Modem::tx_ready()
+{
+    bool ready = (tx_priority == Priority::urgent || !modem_cpsi.lte);
+
+    if (!ready) {
+        ready = (modem_cpsi.rsrp >= bulk_rsrp && modem_cpsi.sinr >= bulk_sinr);
+    }
+
+    if (ready) {
+        // A later dip in link quality may defer the send again
+        tx_hold = false;
+        tx_hold_expired = false;
+        return true;
+    }
+
+    // Keep sending the remaining chunks once the deferral ran out
+    if (tx_hold_expired)
+        return true;
+
+    if (!tx_hold) {
+        LOG_INFO("Deferring bulk send (RSRP %d, SINR %d)\r\n",
+                modem_cpsi.rsrp, modem_cpsi.sinr);
+
+        tx_hold = true;
+        tx_hold_timer = millis();
+    }
+
+    if (bulk_max_defer > 0 && millis() - tx_hold_timer >= bulk_max_defer) {
+        LOG_WARN("Bulk send deferred too long\r\n");
+        tx_hold = false;
+        tx_hold_expired = true;
+        return true;
+    }
+
+    return false;
+}
+
+void Modem::handle_timeout()
+{
+    // A second AT+CMEE? could not be told apart from the first
+    if (pending->tag() == Tag::sync) {
+        LOG_WARN("Resync timeout\r\n");
+        command_timer = millis() + kResyncTimeout;
+        count_timeout();
+        return;
+    }
+
+    // Bare 'AT\r' probe
+    const bool probe = (pending->size() == 3);
+    const bool fs_timeout = (pending->tag() == Tag::filesystem);
+    const bool http_timeout = (pending->tag() == Tag::http);
+    const bool init_timeout = (pending->tag() == Tag::init);
+    const bool pdp_timeout = (pending->tag() == Tag::pdp);
+    const bool user_timeout = (pending->tag() == Tag::user);
+
+    // The modem may still answer a command abandoned before its limit
+    const bool early = (pending_timeout() < pending->timeout());
+
+    // Wait longer for this class until it answers again
+    const size_t timing = static_cast<size_t>(pending->timing());
+    if (latency[timing].backoff < kTimingBackoff)
+        latency[timing].backoff += 1;
+
+    skip_sample = true;
+
+    pending->respond(nullptr, 0);
+    free_pending(false);
+
+    // Probes while booting are covered by kReadyTimeout, but a modem that
+    // stops answering them once ready must still trip the watchdog.
+    if (probe && device_state == State::reset) {
+        if (autobaud())
+            next_baud();
+
+        return;
+    }
+
+    if (http_timeout) {
+        if (http_queued > 0)
+            http_queued -= 1;
+
+        if (http_busy())
+            http_finish(Event::http_error);
+        else if (http_step == HttpStep::connecting) {
+            http_step = HttpStep::idle;
+            emit_event(Event::http_error);
+        }
+        else if (http_step == HttpStep::closing && http_queued == 0)
+            http_step = HttpStep::idle;
+    }
+
+    if (init_timeout) {
+        // Retried with the next poll
+        init_queued &= init_queued - 1;
+    }
+
+    if (pdp_timeout) {
+        if (pdp_step == PdpStep::activating)
+            pdp_finish(Event::pdp_error);
+        else if (pdp_step == PdpStep::deactivating)
+            pdp_step = PdpStep::active;
+    }
+
+    if (fs_timeout) {
+        parser.expect(0);
+        if (fs_step == FsStep::term)
+            fs_done();
+        else if (fs_busy())
+            fs_finish(Event::fs_error);
+    }
+
+    if (early) {
+        resync_flag = true;
+        resync_marker = false;
+    }
+
+    // Only the caller's callback learns of its own command's timeout
+    if (user_timeout)
+        LOG_WARN("User command timeout\r\n");
+    else if (early)
+        LOG_WARN("Response late, resynchronizing\r\n");
+    else {
+        switch (device_state) {
+        case State::reset:
+            case State::ready:
+            break;
+        case State::authenticating:
+            LOG_WARN("Authentication timeout\r\n");
+            set_state(State::searching);
+            emit_event(Event::auth_error);
+            break;
+        case State::handshaking:
+            LOG_WARN("TCP connection timeout\r\n");
+            set_state(State::online);
+            emit_event(Event::conn_error);
+            break;
+        case State::open:
+            LOG_WARN("Socket timeout\r\n");
+            if (cipsend_flag) {
+                cipsend_flag = false;
+                adapt_chunk(false);
+            }
+            emit_event(Event::sock_error);
+            break;
+        case State::closing:
+            LOG_WARN("Close timeout\r\n");
+            set_state(State::online);
+            break;
+        default:
+            LOG_WARN("Command timeout\r\n");
+            emit_event(Event::timeout);
+            break;
+        }
+    }
+
+    count_timeout();
+}
+
+void Modem::count_timeout()
+{
+    // Waiting for the modem to boot is handled by kReadyTimeout
+    if (device_state == State::reset)
+        return;
+
+    timeout_count += 1;
+    if (timeout_count >= kWatchdogTimeouts) {
+        LOG_WARN("%d consecutive timeouts\r\n", timeout_count);
+        trip_watchdog();
+    }
+}
+
+void Modem::resync()
+{
+    // AT+CMEE? - its '+CMEE: ' line is not part of any poll response
+    Command *cmd = new Command(kResyncTimeout, "+CMEE?");
+    if (cmd == nullptr)
+        return;
+
+    cmd->set_tag(Tag::sync);
+    resync_marker = false;
+    send_command(cmd);
 }
 
-int Modem::poll_socket()
+bool Modem::parse_file(uint8_t *start, size_t size)
 {
-    const int rx_requested = (rx_buffer) ? (rx_size - rx_index) : 0;
-    const int tx_requested = (tx_buffer) ? (tx_size - tx_index) : 0;
+    if (fs_rx_pending > 0) {
+        // Raw file data from AT+CFSRFILE
+        size_t count = std::min(size, fs_rx_pending);
+        fs_rx_pending -= count;
 
-    if (rx_requested && modem_rx_available) {
-        int result = socket_receive(rx_requested);
-        if(result < 0)
-            return result;
+        const size_t index = fs_index + fs_chunk;
+        if (count > (fs_size - index))
+            count = (fs_size - index);
+
+        memcpy(fs_rx_buffer + index, start, count);
+        fs_chunk += count;
+        return true;
     }
-    else if (tx_requested && modem_tx_available) {
-        int result = socket_send(tx_buffer + tx_index, tx_requested);
-        if (result < 0)
-            return result;
 
-        cipsend_flag = true;
+    if (size >= 9 && memcmp(start, "DOWNLOAD\r", 9) == 0) {
+        // Write prompt - send the chunk ahead of anything else queued
+        free_pending();
+
+        std::vector<uint8_t> payload(
+                fs_tx_buffer + fs_index,
+                fs_tx_buffer + fs_index + fs_chunk);
+
+        Command *cmd = new Command(10000, payload);
+        if (cmd == nullptr) {
+            fs_finish(Event::fs_error);
+            return true;
+        }
+
+        cmd->set_tag(Tag::filesystem);
+        send_command(cmd);
+        return true;
     }
-    else {
-        Command *cmd = new Command(1000);
-        if (cmd == nullptr)
-            return -ENOMEM;
+    else if (size >= 11 && memcmp(start, "+CFSRFILE: ", 11) == 0) {
+        // +CFSRFILE: %d\r\n%s\r\nOK\r\n
+        // │          │
+        // │          └ start + 11
+        // └ start
 
-        // AT+CSQ - signal quality report
-        cmd->add("+CSQ");
-        // AT+CIPRXGET=4 - query socket unread bytes
-        cmd->add("+CIPRXGET=4");
-        // AT+CIPSEND? - query available size of tx buffer
-        cmd->add("+CIPSEND?");
+        fs_rx_pending = strtoul(
+                reinterpret_cast<char*>(start + 11), nullptr, 10);
 
-        int result = push_command(cmd);
-        if (result != 0) {
-            delete cmd;
-            return result;
+        parser.expect(fs_rx_pending);
+        return true;
+    }
+
+    const bool ok = (size >= 3 && memcmp(start, "OK\r", 3) == 0);
+    const bool error = (size >= 6 && memcmp(start, "ERROR\r", 6) == 0);
+    const bool cme = (size >= 12 && memcmp(start, "+CME ERROR: ", 12) == 0);
+
+    if (!ok && !error && !cme)
+        return false;
+
+    free_pending();
+
+    switch (fs_step) {
+    case FsStep::init:
+        // An error means the buffer is already allocated
+        fs_step = fs_op;
+        break;
+    case FsStep::term:
+        fs_done();
+        break;
+    case FsStep::write:
+    case FsStep::read:
+        if (ok) {
+            const size_t requested = std::min(fs_size - fs_index, kSocketMax);
+            const bool eof = (fs_op == FsStep::read && fs_chunk < requested);
+
+            fs_index += fs_chunk;
+            if (eof)
+                fs_finish(Event::fs_complete);
+            else if (fs_next() != 0)
+                fs_finish(Event::fs_error);
+        }
+        else {
+            fs_finish(Event::fs_error);
         }
+        break;
+    case FsStep::idle:
+        break;
     }
 
-    return 0;
+    // Let parse_urc() report the error code
+    return !cme;
 }
 
-int Modem::socket_receive(size_t size)
+bool Modem::parse_http(uint8_t *start, size_t size)
 {
-    const size_t available = std::min(modem_rx_available, kSocketMax);
-    if (size > available)
-        size = available;
+    if (http_rx_pending > 0) {
+        // Raw body data from AT+SHREAD
+        const size_t count = std::min(size, http_rx_pending);
+        http_rx_pending -= count;
+        http_pos += count;
+
+        const size_t copy = std::min(count, http_size - http_index);
+        memcpy(http_buffer + http_index, start, copy);
+        http_index += copy;
+
+        if (http_rx_pending > 0 || http_step != HttpStep::reading)
+            return true;
+
+        int result = 0;
+        if (http_index >= http_size)
+            http_finish(Event::http_complete);
+        else if (http_pos < http_length)
+            result = http_next();
+        else if (http_code == 206 && http_length == http_range)
+            result = http_request(); // Next range
+        else
+            http_finish(Event::http_complete); // End of the resource
+
+        if (result)
+            http_finish(Event::http_error);
 
-    if (size <= 0)
-        return 0;
+        return true;
+    }
 
-    Command *cmd = new Command();
-    if (cmd == nullptr)
-        return -ENOMEM;
+    if (size >= 8 && memcmp(start, "+SHREQ: ", 8) == 0) {
+        // +SHREQ: "GET",%d,%d\r\n
+        // │             │
+        // │             └ data
+        // └ start
 
-    char buffer[64];
-    int len = snprintf(buffer, sizeof(buffer), "+CIPRXGET=2,%d", size);
-    if (len < 0)
-        return len;
+        char *data = static_cast<char*>(memchr(start, ',', size));
+        if (data == nullptr)
+            return true;
+
+        char *end = nullptr;
+        http_code = strtoul(data + 1, &end, 10);
+        if (*end == ',')
+            http_length = strtoul(end + 1, nullptr, 10);
+
+        if (http_step != HttpStep::requesting)
+            return true;
+
+        // A server that ignores the range can only serve the first one
+        const bool first = (http_offset + http_index == 0);
+        if (http_code != 206 && !(http_code == 200 && first)) {
+            LOG_WARN("HTTP status %d\r\n", http_code);
+            http_finish(Event::http_error);
+        }
+        else if (http_length == 0) {
+            http_finish(Event::http_complete);
+        }
+        else if (http_next() != 0) {
+            http_finish(Event::http_error);
+        }
+        return true;
+    }
+    else if (size >= 9 && memcmp(start, "+SHREAD: ", 9) == 0) {
+        // +SHREAD: %d\r\n%s
+        // │        │
+        // │        └ start + 9
+        // └ start
 
-    // AT+CIPRXGET=2,[size] - read 'size' bytes from the socket
-    cmd->add(buffer, len);
+        http_rx_pending = strtoul(
+                reinterpret_cast<char*>(start + 9), nullptr, 10);
 
-    int result = push_command(cmd);
-    if (result) {
-        delete cmd;
-        return result;
+        if (http_rx_pending > 0)
+            parser.expect(http_rx_pending);
+        else if (http_step == HttpStep::reading)
+            http_finish(Event::http_error);
+
+        return true;
     }
 
-    LOG_VERBOSE("RTR %d bytes (%d)\r\n", size, modem_rx_available);
-    return size;
+    if (pending == nullptr || pending->tag() != Tag::http)
+        return false;
+
+    const bool ok = (size >= 3 && memcmp(start, "OK\r", 3) == 0);
+    const bool error = (size >= 6 && memcmp(start, "ERROR\r", 6) == 0);
+    const bool cme = (size >= 12 && memcmp(start, "+CME ERROR: ", 12) == 0);
+
+    if (!ok && !error && !cme)
+        return false;
+
+    free_pending();
+    if (http_queued > 0)
+        http_queued -= 1;
+
+    switch (http_step) {
+    case HttpStep::connecting:
+        if (!ok) {
+            LOG_WARN("HTTP connection failed\r\n");
+            http_step = HttpStep::idle;
+            emit_event(Event::http_error);
+        }
+        else if (http_queued == 0) {
+            LOG_INFO("HTTP client connected\r\n");
+            http_step = HttpStep::connected;
+            emit_event(Event::http_connected);
+        }
+        break;
+    case HttpStep::closing:
+        if (http_queued == 0)
+            http_step = HttpStep::idle;
+        break;
+    case HttpStep::requesting:
+    case HttpStep::reading:
+        if (!ok)
+            http_finish(Event::http_error);
+        break;
+    default:
+        break;
+    }
+
+    // Let parse_urc() report the error code
+    return !cme;
 }
 
-int Modem::socket_send(const uint8_t *data, size_t size)
+void Modem::pdp_finish(Event event)
 {
-    const size_t available = std::min(modem_tx_available, kSocketMax);
-    if (size > available)
-        size = available;
+    pdp_step = PdpStep::inactive;
+    pdp_ip[0] = '\0';
 
-    if (size > 0) {
-        Command *cmd = new Command(1000);
-        if (cmd == nullptr)
-            return -ENOMEM;
+    if (event == Event::pdp_error)
+        LOG_ERROR("Application network failed to activate\r\n");
+    else
+        LOG_INFO("Application network inactive\r\n");
 
-        char buffer[64];
-        int len = snprintf(buffer, sizeof(buffer), "+CIPSEND=%d", size);
-        if (len < 0)
-            return len;
+    emit_event(event);
+}
 
-        // AT+CIPSEND=[size] - indicate that data is about to be sent
-        cmd->add(buffer, len);
+bool Modem::parse_pdp(uint8_t *start, size_t size)
+{
+    const bool ok = (size >= 3 && memcmp(start, "OK\r", 3) == 0);
+    const bool error = (size >= 6 && memcmp(start, "ERROR\r", 6) == 0)
+        || (size >= 12 && memcmp(start, "+CME ERROR: ", 12) == 0);
 
-        int result = push_command(cmd);
-        if (result) {
-            delete cmd;
-            return result;
+    if (!ok && !error)
+        return false;
+
+    if (error) {
+        if (pdp_step == PdpStep::activating) {
+            pdp_finish(Event::pdp_error);
         }
+        else if (pdp_step == PdpStep::deactivating) {
+            LOG_WARN("Failed to deactivate application network\r\n");
+            pdp_step = PdpStep::active;
+        }
+    }
 
-        // Send the data
-        std::vector<uint8_t> payload(size);
-        memcpy(payload.data(), data, size);
+    free_pending();
+    return true;
+}
 
-        cmd = new Command(10000, payload);
-        if (cmd == nullptr)
-            return -ENOMEM;
+bool Modem::parse_sync(uint8_t *start, size_t size)
+{
+    if (size >= 7 && memcmp(start, "+CMEE: ", 7) == 0) {
+        resync_marker = true;
+        return true;
+    }
 
-        result = push_command(cmd);
-        if (result) {
-            delete cmd;
-            return result;
-        }
+    const bool final = (size >= 3 && memcmp(start, "OK\r", 3) == 0)
+        || (size >= 6 && memcmp(start, "ERROR\r", 6) == 0)
+        || (size >= 12 && memcmp(start, "+CME ERROR: ", 12) == 0);
+
+    // Other lines are still handled, only a result code could be mistaken
+    // for the answer to the next command
+    if (!final)
+        return false;
+
+    if (resync_marker) {
+        LOG_VERBOSE("Resynchronized\r\n");
+        resync_flag = false;
+        resync_marker = false;
+        free_pending();
     }
 
-    LOG_VERBOSE("RTS %d bytes (%d)\r\n", size, (tx_size - tx_index));
-    return size;
+    return true;
 }
 
-void Modem::handle_timeout()
+bool Modem::parse_init(uint8_t *start, size_t size)
 {
-    // Ignore timeouts for 'AT\r'
-    const bool ignored = (pending->size() == 3);
+    const bool ok = (size >= 3 && memcmp(start, "OK\r", 3) == 0);
+    const bool error = (size >= 6 && memcmp(start, "ERROR\r", 6) == 0)
+        || (size >= 12 && memcmp(start, "+CME ERROR: ", 12) == 0);
 
-    free_pending();
+    if (!ok && !error)
+        return false;
 
-    if (ignored)
-        return;
+    // Steps complete in the order they were queued
+    const uint16_t step = init_queued & -init_queued;
+    init_queued &= ~step;
 
-    switch (device_state) {
-    case State::reset:
-        case State::ready:
-        break;
-    case State::authenticating:
-        LOG_WARN("Authentication timeout\r\n");
-        set_state(State::searching);
-        emit_event(Event::auth_error);
-        break;
-    case State::handshaking:
-        LOG_WARN("TCP connection timeout\r\n");
-        set_state(State::online);
-        emit_event(Event::conn_error);
-        break;
-    case State::open:
-        LOG_WARN("Socket timeout\r\n");
-        emit_event(Event::sock_error);
-        break;
-    case State::closing:
-        LOG_WARN("Close timeout\r\n");
-        set_state(State::online);
-        break;
-    default:
-        LOG_WARN("Command timeout\r\n");
-        emit_event(Event::timeout);
-        break;
+    for (size_t i = 0; i < kInitSteps; ++i) {
+        if (step != (1u << i))
+            continue;
+
+        if (!error) {
+            LOG_VERBOSE("Set %s\r\n", kInitSequence[i].name);
+            init_done |= step;
+        }
+        else if (init_errors[i] < kInitRetries) {
+            // Retried with the next poll
+            LOG_WARN("Retrying %s\r\n", kInitSequence[i].name);
+            init_errors[i] += 1;
+        }
+        else {
+            LOG_ERROR("Failed to set %s\r\n", kInitSequence[i].name);
+            init_done |= step;
+            init_failed |= step;
+        }
     }
+
+    if (init_done == kInitComplete)
+        LOG_INFO("Modem initialized\r\n");
+
+    free_pending();
+    return true;
 }
 
 bool Modem::parse_urc(uint8_t *start, size_t size)
 {
-    if (size >= 12 && memcmp(start, "+CME ERROR:", 12) == 0) {
+    if (size >= 12 && memcmp(start, "+CME ERROR: ", 12) == 0) {
         // +CME ERROR: %d\r\n
         // │           │
         // │           └ start + 12
@@ -709,6 +2427,7 @@ bool Modem::parse_urc(uint8_t *start, size_t size)
                 reinterpret_cast<char*>(start + 12), nullptr, 10);
 
         LOG_ERROR("+CME ERROR: %d\r\n", error);
+        cme_error = error;
         emit_error(error);
         return true;
     }
@@ -748,12 +2467,60 @@ bool Modem::parse_urc(uint8_t *start, size_t size)
         }
         return true;
     }
+    else if (size >= 10 && memcmp(start, "+APP PDP: ", 10) == 0) {
+        // +APP PDP: %s\r\n
+        // │         │
+        // │         └ data
+        // └ start
+
+        const uint8_t *data = start + 10;
+        const size_t remaining = size - 10;
+
+        if (remaining >= 7 && memcmp(data, "ACTIVE\r", 7) == 0) {
+            LOG_INFO("Application network active\r\n");
+            pdp_step = PdpStep::active;
+
+            // AT+CNACT? - query the network address
+            Command *cmd = new Command(kDefaultTimeout, "+CNACT?");
+            if (cmd != nullptr && push_command(cmd) != 0)
+                delete cmd;
+
+            emit_event(Event::pdp_active);
+        }
+        else if (remaining >= 9 && memcmp(data, "DEACTIVE\r", 9) == 0) {
+            if (pdp_step != PdpStep::inactive)
+                pdp_finish(Event::pdp_inactive);
+        }
+        return true;
+    }
+    else if (size >= 4 && memcmp(start, "RDY\r", 4) == 0) {
+        // The modem restarted on its own, so its settings were lost
+        if (status() != State::reset) {
+            LOG_WARN("Modem restarted\r\n");
+            clear_commands();
+            reset_device();
+        }
+        return true;
+    }
     else if (size >= 12 && memcmp(start, "+PDP: DEACT\r", 12) == 0) {
         if (status() > State::registered) {
+            // The socket is gone along with the context
+            stop_send();
+            stop_receive();
+
             set_state(State::registered);
         }
         return true;
     }
+    else if (size >= 10 && memcmp(start, "+UGNSINF: ", 10) == 0) {
+        // +UGNSINF: %d,%d,%s,...\r\n
+        // │         │
+        // │         └ start + 10
+        // └ start
+
+        parse_gnss_fix(start + 10, size - 10);
+        return true;
+    }
 
     return false;
 }
@@ -772,34 +2539,77 @@ void Modem::parse_general(uint8_t *start, size_t size)
         modem_csq = strtoul(reinterpret_cast<char*>(start), nullptr, 10);
     }
     else if (size >= 7 && memcmp(start, "+CREG: ", 7) == 0) {
-        // +CREG: %d,%d\r\n
-        // │        │
-        // │        └ data
-        // └ start
+        // +CREG: %d,%d[,%s,%s]\r\n  or  +CREG: %d[,%s,%s]\r\n
+        // │      │                        │      │
+        // │      └ start + 7              │      └ start + 7
+        // └ start                         └ start
 
-        char *data = static_cast<char*>(memchr(start, ',', size));
-        if (data != nullptr)
-            modem_creg = strtoul(data + 1, nullptr, 10);
+        bool urc = false;
+        modem_creg = parse_registration(start + 7, size - 7, urc);
+        if (urc)
+            handle_registration();
     }
     else if (size >= 8 && memcmp(start, "+CGREG: ", 8) == 0) {
         // +CGREG: %d,%d\r\n
-        // │         │
-        // │         └ data
+        // │       │
+        // │       └ start + 8
         // └ start
 
-        char *data = static_cast<char*>(memchr(start, ',', size));
-        if (data != nullptr)
-            modem_cgreg = strtoul(data + 1, nullptr, 10);
+        bool urc = false;
+        modem_cgreg = parse_registration(start + 8, size - 8, urc);
+        if (urc)
+            handle_registration();
     }
     else if (size >= 8 && memcmp(start, "+CEREG: ", 8) == 0) {
-        // +CEREG: %d,%d\r\n
+        // +CEREG: %d,%d[,%s,%s,%d]\r\n  or  +CEREG: %d[,%s,%s,%d]\r\n
+        // │       │                           │       │
+        // │       └ start + 8                 │       └ start + 8
+        // └ start                             └ start
+
+        bool urc = false;
+        modem_cereg = parse_registration(start + 8, size - 8, urc);
+        if (urc)
+            handle_registration();
+    }
+    else if (size >= 10 && memcmp(start, "+CGNSINF: ", 10) == 0) {
+        // +CGNSINF: %d,%d,%s,...\r\n
         // │         │
-        // │         └ data
+        // │         └ start + 10
         // └ start
 
-        char *data = static_cast<char*>(memchr(start, ',', size));
-        if (data != nullptr)
-            modem_cereg = strtoul(data + 1, nullptr, 10);
+        parse_gnss_fix(start + 10, size - 10);
+    }
+    else if (size >= 8 && memcmp(start, "+CNACT: ", 8) == 0) {
+        // +CNACT: %d,"%s"\r\n
+        // │       │  │
+        // │       │  └ ip
+        // │       └ start + 8
+        // └ start
+
+        char *data = reinterpret_cast<char*>(start + 8);
+        const uint8_t active = strtoul(data, nullptr, 10);
+        char *end = reinterpret_cast<char*>(start) + size;
+        char *ip = static_cast<char*>(memchr(data, '"', end - data));
+        char *ip_end = (ip) ? static_cast<char*>(
+                memchr(ip + 1, '"', end - ip - 1)) : nullptr;
+
+        if (pdp_step == PdpStep::active) {
+            if (active == 0) {
+                pdp_finish(Event::pdp_inactive);
+            }
+            else if (ip_end && ip_end - ip <= (int) sizeof(pdp_ip)) {
+                memcpy(pdp_ip, ip + 1, ip_end - ip - 1);
+                pdp_ip[ip_end - ip - 1] = '\0';
+            }
+        }
+    }
+    else if (size >= 7 && memcmp(start, "+CPSI: ", 7) == 0) {
+        // +CPSI: %s,%s,...,<rsrq>,<rsrp>,<rssi>,<sinr>\r\n
+        // │      │
+        // │      └ start + 7
+        // └ start
+
+        parse_cpsi(start + 7, size - 7);
     }
     else if (size >= 8 && memcmp(start, "+CGATT: ", 8) == 0) {
         // +CGATT: %d\r\n
@@ -877,6 +2687,10 @@ void Modem::parse_handshaking(uint8_t *start, size_t size)
         LOG_INFO("TCP socket connected\r\n");
         ciprxget_flag = false;
         cipsend_flag = false;
+
+        // Learn the link again for each connection
+        chunk_size = kChunkStart;
+        chunk_loss = 0;
         set_state(State::open);
         free_pending();
     }
@@ -910,11 +2724,6 @@ void Modem::parse_closing(uint8_t *start, size_t size)
 
 void Modem::parse_socket(uint8_t *start, size_t size)
 {
-    if(ciprxget_flag) {
-        parse_socket_receive(start, size);
-        return;
-    }
-
     if(cipsend_flag)
         parse_socket_send(start, size);
 
@@ -957,19 +2766,41 @@ void Modem::parse_socket_command(uint8_t *start, size_t size)
         modem_rx_available = count;
     }
     else if (size >= 13 && memcmp(start, "+CIPRXGET: 2,", 13) == 0) {
-        // +CIPRXGET: 2,%d,%d,%s\r\n%s\r\n
-        // │            │
+        // +CIPRXGET: 2,%d,%d\r\n%s\r\nOK\r\n
+        // │            │  │
+        // │            │  └ remaining
         // │            └ start + 13
         // └ start
 
         start += 13;
         size -= 13;
 
+        char *end = nullptr;
         modem_rx_pending = strtoul(
-                reinterpret_cast<char*>(start), nullptr, 10);
+                reinterpret_cast<char*>(start), &end, 10);
+
+        if (*end == ',') {
+            // Also learns of data that arrived since the last poll
+            modem_rx_available = strtoul(end + 1, nullptr, 10);
+        }
+        else {
+            modem_rx_available -= std::min(
+                    modem_rx_pending, modem_rx_available);
+        }
 
-        modem_rx_available -= modem_rx_pending;
-        ciprxget_flag = true;
+        // Socket data is binary, don't split it into lines
+        parser.expect(modem_rx_pending);
+        ciprxget_flag = (modem_rx_pending > 0);
+
+        // Chain the next read instead of waiting for a poll. Leave it to
+        // poll_socket() to share the socket while a send is waiting.
+        const size_t requested = (rx_buffer) ? (rx_size - rx_index) : 0;
+        const bool tx_waiting = tx_buffer && tx_index < tx_size;
+
+        if (requested > modem_rx_pending && modem_rx_available > 0
+                && !tx_waiting) {
+            socket_receive(requested - modem_rx_pending);
+        }
     }
     else if (size >= 10 && memcmp(start, "+CIPSEND: ", 10) == 0) {
         // +CIPSEND: %d\r\nOK\r\n
@@ -992,6 +2823,7 @@ void Modem::parse_socket_receive(uint8_t *start, size_t size)
         count = size;
 
     modem_rx_pending -= count;
+    rx_total_count += count;
 
     if (rx_buffer && rx_index < rx_size) {
         if (count > (rx_size - rx_index))
@@ -1019,22 +2851,43 @@ void Modem::parse_socket_send(uint8_t *start, size_t size)
         // Send prompt
         free_pending();
     }
-    else if (size >= 8 && memcmp(start, "SEND OK\r", 8) == 0) {
-        // Response to AT+CIPSEND
+    else if ((size >= 8 && memcmp(start, "SEND OK\r", 8) == 0)
+            || (size >= 12 && memcmp(start, "DATA ACCEPT:", 12) == 0)) {
+        // Response to AT+CIPSEND (DATA ACCEPT if AT+CIPQSEND=1)
         const size_t count = pending->size();
         tx_index += count;
+        tx_total_count += count;
+
+        // The chunk left the modem's buffer
+        modem_tx_available += count;
 
         LOG_INFO("Sent %d bytes\r\n", count);
 
         cipsend_flag = false;
+        adapt_chunk(true);
         if (tx_index == tx_size)
-            emit_event(Event::rx_complete);
+            emit_event(Event::tx_complete);
 
         free_pending();
+
+        // Send the next chunk on the remaining credit instead of polling.
+        // Leave it to poll_socket() to share the socket with a receive.
+        const bool rx_waiting = rx_buffer && rx_index < rx_size
+            && modem_rx_available > 0;
+
+        if (tx_buffer && tx_index < tx_size && modem_tx_available > 0
+                && !rx_waiting && tx_ready()) {
+            if (socket_send(tx_buffer + tx_index, tx_size - tx_index) > 0)
+                cipsend_flag = true;
+        }
     }
     else if (size >= 10 && memcmp(start, "SEND FAIL\r", 10) == 0) {
-        // Response to AT+CIPSEND
+        // Response to AT+CIPSEND - the chunk was dropped
+        if (pending)
+            modem_tx_available += pending->size();
+
         cipsend_flag = false;
+        adapt_chunk(false);
         emit_event(Event::sock_error);
         free_pending();
     }
@@ -1048,15 +2901,64 @@ void Modem::parse_callback(uint8_t *start, size_t size, void *user)
     print_buffer(start, size);
 #endif
 
-    // Discard echo
-    if (size >= 2 && memcmp(start, "AT", 2) == 0) {
-        if (ctx->status() != State::reset) {
-            // ATE0 - disable echo
-            Command *cmd = new Command(1000, "E0");
-            if (ctx->push_command(cmd) != 0)
-                delete cmd;
-        }
+    // The modem is alive
+    ctx->timeout_count = 0;
+
+    // Raw socket data from AT+CIPRXGET=2 is never a response
+    if (ctx->ciprxget_flag) {
+        ctx->parse_socket_receive(start, size);
+        return;
+    }
+
+    // Late responses to an abandoned command
+    if (ctx->pending && ctx->pending->tag() == Tag::sync) {
+        if (ctx->parse_sync(start, size))
+            return;
+    }
+
+    // Modem filesystem transfers
+    if (ctx->fs_rx_pending > 0
+            || (ctx->pending && ctx->pending->tag() == Tag::filesystem)) {
+        if (ctx->parse_file(start, size))
+            return;
+    }
+
+    // Modem HTTP client
+    if (ctx->http_rx_pending > 0
+            || ctx->http_step != HttpStep::idle
+            || (ctx->pending && ctx->pending->tag() == Tag::http)) {
+        if (ctx->parse_http(start, size))
+            return;
+    }
+
+    // Discard echo until the initialization sequence disables it
+    if (size >= 2 && memcmp(start, "AT", 2) == 0)
         return;
+
+    // Initialization sequence
+    if (ctx->pending && ctx->pending->tag() == Tag::init) {
+        if (ctx->parse_init(start, size))
+            return;
+    }
+
+    // Application network
+    if (ctx->pending && ctx->pending->tag() == Tag::pdp) {
+        if (ctx->parse_pdp(start, size))
+            return;
+    }
+
+    // Route responses to user commands
+    if (ctx->pending && ctx->pending->tag() == Tag::user) {
+        ctx->pending->respond(start, size);
+
+        if ((size >= 3 && memcmp(start, "OK\r", 3) == 0)
+                || (size >= 6 && memcmp(start, "ERROR\r", 6) == 0)) {
+            ctx->free_pending();
+            return;
+        }
+
+        if (size >= 12 && memcmp(start, "+CME ERROR: ", 12) == 0)
+            ctx->free_pending();
     }
 
     // Unsolicited Result Codes
@@ -1081,6 +2983,14 @@ void Modem::parse_callback(uint8_t *start, size_t size, void *user)
         if (size >= 3 && memcmp(start, "OK\r", 3) == 0) {
             ctx->free_pending();
             ctx->probe_flag = true;
+
+            if (ctx->autobaud()) {
+                if (ctx->baud_rate) {
+                    LOG_INFO("Modem found at %lu baud\r\n",
+                            (unsigned long) ctx->baud_rate);
+                }
+                ctx->baud_locked = true;
+            }
         }
         break;
     }
@@ -13,20 +13,58 @@
 
 namespace gsm {
 
+/** Tokens that the modem begins a response line with. */
+static const char *const kLineStarts[] = {
+    "+", "OK\r", "ERROR\r", "RDY\r", "CLOSE", "CONNECT", "ALREADY CONNECT",
+    "SEND OK\r", "SEND FAIL\r", "DATA ACCEPT:",
+};
+
+/**
+ * @brief Check if a line could start at 'data'.
+ *
+ * @param [in] data - buffer.
+ * @param [in] size - length of buffer.
+ * @return true if 'data' begins with, or is the beginning of, a known token.
+ */
+static bool is_line_start(const uint8_t *data, size_t size)
+{
+    for (const char *token : kLineStarts) {
+        size_t length = strlen(token);
+        if (length > size)
+            length = size;
+
+        if (memcmp(data, token, length) == 0)
+            return true;
+    }
+
+    return false;
+}
+
 void Parser::load(const uint8_t *data, size_t size)
 {
     for (size_t i = 0; i < size; ++i) {
-        buffer[head++] = data[i];
-        count += 1;
-
         if (head >= kBufferSize) {
+            if (tail == 0 && raw_count > 0) {
+                // Pass on the part of the raw data that fit
+                emit_data(buffer, count);
+                raw_count -= count;
+                tail += count;
+                count = 0;
+            }
+            else if (tail == 0) {
+                // A full buffer without a line ending means framing is lost
+                discard(resync(buffer, count));
+            }
+
             // Shift unprocessed bytes back to index 0
             memmove(buffer, buffer + tail, count);
             tail = 0;
             head = count;
-            continue;
         }
 
+        buffer[head++] = data[i];
+        count += 1;
+
         while (count > 0) {
             int result = try_parse(buffer + tail, count);
             if (result > 0) {
@@ -35,9 +73,12 @@ void Parser::load(const uint8_t *data, size_t size)
                 count -= result;
             }
             else if (result == -EINVAL) {
-                // Invalid packet
-                tail += 1;
-                count -= 1;
+                // Invalid packet - skip to the end of the line
+                const uint8_t *start = buffer + tail;
+                const uint8_t *end = static_cast<const uint8_t*>(
+                        memchr(start, '\n', count));
+
+                discard((end - start) + 1);
             }
             else if (result == -EAGAIN) {
                 // Need more data
@@ -53,6 +94,35 @@ void Parser::load(const uint8_t *data, size_t size)
     }
 }
 
+size_t Parser::resync(const uint8_t *data, size_t size) const
+{
+    for (size_t i = 1; i < size; ++i) {
+        if (data[i - 1] != '\r' && data[i - 1] != '\n')
+            continue;
+
+        if (is_line_start(data + i, size - i))
+            return i;
+    }
+
+    // Nothing plausible - keep a trailing '\r' that may begin a new line
+    if (data[size - 1] == '\r')
+        return size - 1;
+
+    return size;
+}
+
+void Parser::discard(size_t size)
+{
+    for (size_t i = 0; i < size; ++i) {
+        const uint8_t c = buffer[tail + i];
+        if (c != '\r' && c != '\n')
+            discard_count += 1;
+    }
+
+    tail += size;
+    count -= size;
+}
+
 void Parser::set_parse_callback(parse_cb_t func, void *user)
 {
     parse_cb = func;
@@ -61,6 +131,17 @@ void Parser::set_parse_callback(parse_cb_t func, void *user)
 
 int Parser::try_parse(uint8_t *data, size_t size)
 {
+    if (raw_count > 0) {
+        if (size < raw_count)
+            return -EAGAIN;
+
+        const size_t length = raw_count;
+        raw_count = 0;
+
+        emit_data(data, length);
+        return length;
+    }
+
     uint8_t *end = static_cast<uint8_t*>(memchr(data, '\n', size));
     if (end == nullptr) {
         if (*data == '>') {
@@ -0,0 +1,292 @@
+/**
+ * @file serial.cpp
+ * @brief Low latency Linux serial port for the driver.
+ * @author Wilkins White
+ * @copyright 2024 Nova Dynamics LLC
+ */
+
+#include <errno.h>
+
+#include "debug.h"
+#include "serial.h"
+
+#if defined(__linux__)
+#define NOVAGSM_SERIAL_LINUX 1
+#include <fcntl.h>
+#include <poll.h>
+#include <linux/serial.h>
+#include <sys/file.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+namespace gsm {
+
+Serial *Serial::active = nullptr;
+
+Serial::~Serial()
+{
+    close();
+}
+
+context_t Serial::context()
+{
+    context_t ctx = {};
+    ctx.read = read;
+    ctx.write = write;
+    ctx.millis = millis;
+    ctx.set_baud = change_baud;
+
+    if (active) {
+        ctx.baud = active->port_baud;
+        ctx.flow = active->port_flow;
+    }
+
+    return ctx;
+}
+
+void Serial::process(Modem &modem)
+{
+    Serial *previous = active;
+    active = this;
+    modem.process();
+    active = previous;
+}
+
+void Serial::change_baud(uint32_t baud)
+{
+    if (active)
+        active->set_baud(baud);
+}
+
+#if defined(NOVAGSM_SERIAL_LINUX)
+
+/** Longest time to wait for the port to accept more data (ms). */
+static constexpr int kWriteTimeout = 1000;
+
+/** Returns the termios speed for 'baud', or B0 if unsupported. */
+static speed_t speed(uint32_t baud)
+{
+    switch (baud) {
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+    case 460800: return B460800;
+    case 921600: return B921600;
+    default: return B0;
+    }
+}
+
+int Serial::open(const char *path, uint32_t baud, bool flow)
+{
+    if (port_fd >= 0)
+        return -EALREADY;
+
+    const speed_t rate = speed(baud);
+    if (path == nullptr || rate == B0)
+        return -EINVAL;
+
+    int fd = ::open(path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0)
+        return -errno;
+
+    // Keep other processes (e.g. ModemManager) off the port
+    if (flock(fd, LOCK_EX | LOCK_NB) < 0) {
+        ::close(fd);
+        return -EBUSY;
+    }
+
+    ioctl(fd, TIOCEXCL);
+
+    struct termios settings;
+    if (tcgetattr(fd, &settings) < 0) {
+        const int result = -errno;
+        ::close(fd);
+        return result;
+    }
+
+    cfmakeraw(&settings);
+    settings.c_cflag |= CLOCAL | CREAD;
+
+    if (flow)
+        settings.c_cflag |= CRTSCTS;
+    else
+        settings.c_cflag &= ~CRTSCTS;
+
+    // Wake poll() on the first byte, read() still returns immediately
+    settings.c_cc[VMIN] = 1;
+    settings.c_cc[VTIME] = 0;
+
+    cfsetispeed(&settings, rate);
+    cfsetospeed(&settings, rate);
+
+    if (tcsetattr(fd, TCSANOW, &settings) < 0) {
+        const int result = -errno;
+        ::close(fd);
+        return result;
+    }
+
+    tcflush(fd, TCIOFLUSH);
+
+    // Not every driver supports this, e.g. some USB adapters
+    struct serial_struct serial;
+    latency_set = false;
+    if (ioctl(fd, TIOCGSERIAL, &serial) == 0) {
+        serial.flags |= ASYNC_LOW_LATENCY;
+        latency_set = (ioctl(fd, TIOCSSERIAL, &serial) == 0);
+    }
+
+    if (!latency_set)
+        LOG_WARN("Low latency mode not supported by %s\r\n", path);
+
+    port_fd = fd;
+    port_baud = baud;
+    port_flow = flow;
+
+    if (active == nullptr)
+        active = this;
+
+    LOG_INFO("Opened %s at %lu baud\r\n", path, (unsigned long) baud);
+    return 0;
+}
+
+void Serial::close()
+{
+    if (active == this)
+        active = nullptr;
+
+    if (port_fd < 0)
+        return;
+
+    // Releases the lock
+    ::close(port_fd);
+    port_fd = -1;
+}
+
+int Serial::set_baud(uint32_t baud)
+{
+    if (port_fd < 0)
+        return -ENOTCONN;
+
+    const speed_t rate = speed(baud);
+    if (rate == B0)
+        return -EINVAL;
+
+    struct termios settings;
+    if (tcgetattr(port_fd, &settings) < 0)
+        return -errno;
+
+    cfsetispeed(&settings, rate);
+    cfsetospeed(&settings, rate);
+
+    // Drop bytes received at the old rate
+    if (tcsetattr(port_fd, TCSAFLUSH, &settings) < 0)
+        return -errno;
+
+    port_baud = baud;
+    return 0;
+}
+
+uint32_t Serial::millis()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+int Serial::read(void *data, size_t size)
+{
+    if (active == nullptr || active->port_fd < 0)
+        return -1;
+
+    return ::read(active->port_fd, data, size);
+}
+
+int Serial::write(const void *data, size_t size)
+{
+    if (active == nullptr || active->port_fd < 0)
+        return -1;
+
+    // The port is non-blocking and CTS may hold off the transmitter, so
+    // wait for room instead of dropping part of a command.
+    const uint8_t *p = static_cast<const uint8_t*>(data);
+    size_t count = 0;
+
+    while (count < size) {
+        const ssize_t result = ::write(
+                active->port_fd, p + count, size - count);
+        if (result > 0) {
+            count += result;
+            continue;
+        }
+
+        if (result < 0 && errno == EINTR)
+            continue;
+
+        if (result < 0 && errno != EAGAIN)
+            return (count > 0) ? (int) count : -1;
+
+        struct pollfd pfd = { active->port_fd, POLLOUT, 0 };
+        const int ready = poll(&pfd, 1, kWriteTimeout);
+        if (ready < 0 && errno == EINTR)
+            continue;
+
+        if (ready <= 0) {
+            LOG_WARN("Serial write stalled, dropped %lu bytes\r\n",
+                    (unsigned long) (size - count));
+            break;
+        }
+    }
+
+    return count;
+}
+
+#else
+
+int Serial::open(const char *path, uint32_t baud, bool flow)
+{
+    (void) path;
+    (void) baud;
+    (void) flow;
+    return -ENOSYS;
+}
+
+void Serial::close()
+{
+    if (active == this)
+        active = nullptr;
+}
+
+int Serial::set_baud(uint32_t baud)
+{
+    (void) baud;
+    return -ENOTCONN;
+}
+
+uint32_t Serial::millis()
+{
+    return 0;
+}
+
+int Serial::read(void *data, size_t size)
+{
+    (void) data;
+    (void) size;
+    return -1;
+}
+
+int Serial::write(const void *data, size_t size)
+{
+    (void) data;
+    (void) size;
+    return -1;
+}
+
+#endif
+
+} // namespace gsm
@@ -0,0 +1,329 @@
+/**
+ * @file sha256.cpp
+ * @brief Incremental SHA-256 hash.
+ * @author Wilkins White
+ * @copyright 2024 Nova Dynamics LLC
+ */
+
+#include <cstring>
+
+#include "sha256.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define NOVAGSM_SHA256_X86 1
+#include <cpuid.h>
+#include <immintrin.h>
+#elif defined(__ARM_FEATURE_SHA2) || defined(__ARM_FEATURE_CRYPTO)
+#define NOVAGSM_SHA256_ARM 1
+#include <arm_neon.h>
+#endif
+
+namespace gsm {
+
+/** Round constants. */
+alignas(16) static const uint32_t kRound[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+    0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+    0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+    0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+    0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+    0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+/** Initial hash value. */
+static const uint32_t kInitial[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+typedef void (*transform_t)(uint32_t *state, const uint8_t *data, size_t n);
+
+static inline uint32_t rotr(uint32_t x, int n)
+{
+    return (x >> n) | (x << (32 - n));
+}
+
+/**
+ * @brief Hash 'n' 64 byte blocks.
+ *
+ * @param [in,out] state - intermediate hash value.
+ * @param [in] data - blocks to hash.
+ * @param [in] n - number of blocks.
+ */
+static void transform_generic(uint32_t *state, const uint8_t *data, size_t n)
+{
+    uint32_t w[64];
+
+    for (; n > 0; --n, data += 64) {
+        for (int i = 0; i < 16; ++i) {
+            w[i] = (static_cast<uint32_t>(data[i * 4]) << 24)
+                | (static_cast<uint32_t>(data[i * 4 + 1]) << 16)
+                | (static_cast<uint32_t>(data[i * 4 + 2]) << 8)
+                | (static_cast<uint32_t>(data[i * 4 + 3]));
+        }
+
+        for (int i = 16; i < 64; ++i) {
+            const uint32_t s0 = rotr(w[i - 15], 7)
+                ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+
+            const uint32_t s1 = rotr(w[i - 2], 17)
+                ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+        for (int i = 0; i < 64; ++i) {
+            const uint32_t s1 = rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25);
+            const uint32_t ch = (e & f) ^ (~e & g);
+            const uint32_t t1 = h + s1 + ch + kRound[i] + w[i];
+            const uint32_t s0 = rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22);
+            const uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+            const uint32_t t2 = s0 + maj;
+
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+    }
+}
+
+#if defined(NOVAGSM_SHA256_X86)
+
+/** Returns true if the processor supports the SHA extensions. */
+static bool cpu_has_sha()
+{
+    unsigned int a, b, c, d;
+
+    // SSSE3 and SSE4.1
+    if (!__get_cpuid(1, &a, &b, &c, &d))
+        return false;
+
+    if (!(c & (1u << 9)) || !(c & (1u << 19)))
+        return false;
+
+    // SHA
+    if (!__get_cpuid_count(7, 0, &a, &b, &c, &d))
+        return false;
+
+    return (b & (1u << 29)) != 0;
+}
+
+/** Hash 'n' 64 byte blocks using the x86 SHA extensions. */
+__attribute__((target("sha,sse4.1")))
+static void transform_x86(uint32_t *state, const uint8_t *data, size_t n)
+{
+    const __m128i mask = _mm_set_epi64x(
+            0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    // The instructions operate on ABEF/CDGH rather than ABCD/EFGH
+    __m128i tmp = _mm_loadu_si128(reinterpret_cast<const __m128i*>(state));
+    __m128i state1 = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(state + 4));
+
+    tmp = _mm_shuffle_epi32(tmp, 0xb1);
+    state1 = _mm_shuffle_epi32(state1, 0x1b);
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xf0);
+
+    for (; n > 0; --n, data += 64) {
+        const __m128i abef = state0;
+        const __m128i cdgh = state1;
+
+        __m128i msg[4];
+        for (int i = 0; i < 4; ++i) {
+            msg[i] = _mm_shuffle_epi8(_mm_loadu_si128(
+                    reinterpret_cast<const __m128i*>(data + i * 16)), mask);
+        }
+
+        for (int i = 0; i < 16; ++i) {
+            __m128i wk = _mm_add_epi32(msg[i & 3], _mm_load_si128(
+                    reinterpret_cast<const __m128i*>(kRound + i * 4)));
+
+            state1 = _mm_sha256rnds2_epu32(state1, state0, wk);
+            wk = _mm_shuffle_epi32(wk, 0x0e);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, wk);
+
+            if (i < 12) {
+                // Schedule the words for rounds (i + 4) * 4
+                __m128i w = _mm_sha256msg1_epu32(
+                        msg[i & 3], msg[(i + 1) & 3]);
+
+                w = _mm_add_epi32(w, _mm_alignr_epi8(
+                        msg[(i + 3) & 3], msg[(i + 2) & 3], 4));
+
+                msg[i & 3] = _mm_sha256msg2_epu32(w, msg[(i + 3) & 3]);
+            }
+        }
+
+        state0 = _mm_add_epi32(state0, abef);
+        state1 = _mm_add_epi32(state1, cdgh);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1b);
+    state1 = _mm_shuffle_epi32(state1, 0xb1);
+    state0 = _mm_blend_epi16(tmp, state1, 0xf0);
+    state1 = _mm_alignr_epi8(state1, tmp, 8);
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state), state0);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state + 4), state1);
+}
+
+#elif defined(NOVAGSM_SHA256_ARM)
+
+/** Hash 'n' 64 byte blocks using the ARMv8 cryptography extensions. */
+static void transform_arm(uint32_t *state, const uint8_t *data, size_t n)
+{
+    uint32x4_t state0 = vld1q_u32(state);
+    uint32x4_t state1 = vld1q_u32(state + 4);
+
+    for (; n > 0; --n, data += 64) {
+        const uint32x4_t abcd = state0;
+        const uint32x4_t efgh = state1;
+
+        uint32x4_t msg[4];
+        for (int i = 0; i < 4; ++i) {
+            msg[i] = vreinterpretq_u32_u8(
+                    vrev32q_u8(vld1q_u8(data + i * 16)));
+        }
+
+        for (int i = 0; i < 16; ++i) {
+            const uint32x4_t wk = vaddq_u32(
+                    msg[i & 3], vld1q_u32(kRound + i * 4));
+
+            const uint32x4_t prev = state0;
+            state0 = vsha256hq_u32(state0, state1, wk);
+            state1 = vsha256h2q_u32(state1, prev, wk);
+
+            if (i < 12) {
+                // Schedule the words for rounds (i + 4) * 4
+                msg[i & 3] = vsha256su1q_u32(
+                        vsha256su0q_u32(msg[i & 3], msg[(i + 1) & 3]),
+                        msg[(i + 2) & 3], msg[(i + 3) & 3]);
+            }
+        }
+
+        state0 = vaddq_u32(state0, abcd);
+        state1 = vaddq_u32(state1, efgh);
+    }
+
+    vst1q_u32(state, state0);
+    vst1q_u32(state + 4, state1);
+}
+
+#endif
+
+/** Select the fastest implementation supported by the processor. */
+static transform_t select_transform()
+{
+#if defined(NOVAGSM_SHA256_X86)
+    if (cpu_has_sha())
+        return transform_x86;
+#elif defined(NOVAGSM_SHA256_ARM)
+    return transform_arm;
+#endif
+    return transform_generic;
+}
+
+/** Hash 'n' 64 byte blocks. */
+static void transform(uint32_t *state, const uint8_t *data, size_t n)
+{
+    static const transform_t func = select_transform();
+    func(state, data, n);
+}
+
+Sha256::Sha256()
+{
+    reset();
+}
+
+void Sha256::reset()
+{
+    memcpy(state, kInitial, sizeof(state));
+    length = 0;
+}
+
+void Sha256::update(const void *data, size_t size)
+{
+    const uint8_t *p = static_cast<const uint8_t*>(data);
+    size_t used = length % 64;
+    length += size;
+
+    if (used > 0) {
+        // Fill the partial block
+        const size_t count = (size < (64 - used)) ? size : (64 - used);
+        memcpy(buffer + used, p, count);
+        used += count;
+        p += count;
+        size -= count;
+
+        if (used < 64)
+            return;
+
+        transform(state, buffer, 1);
+    }
+
+    // Hash whole blocks straight from the input
+    const size_t blocks = size / 64;
+    if (blocks > 0) {
+        transform(state, p, blocks);
+        p += blocks * 64;
+        size -= blocks * 64;
+    }
+
+    memcpy(buffer, p, size);
+}
+
+void Sha256::finish(uint8_t *digest)
+{
+    const uint64_t bits = length * 8;
+    size_t used = length % 64;
+
+    buffer[used++] = 0x80;
+    if (used > 56) {
+        memset(buffer + used, 0, 64 - used);
+        transform(state, buffer, 1);
+        used = 0;
+    }
+
+    memset(buffer + used, 0, 56 - used);
+    for (int i = 0; i < 8; ++i)
+        buffer[56 + i] = static_cast<uint8_t>(bits >> (56 - i * 8));
+
+    transform(state, buffer, 1);
+
+    for (int i = 0; i < 8; ++i) {
+        digest[i * 4] = static_cast<uint8_t>(state[i] >> 24);
+        digest[i * 4 + 1] = static_cast<uint8_t>(state[i] >> 16);
+        digest[i * 4 + 2] = static_cast<uint8_t>(state[i] >> 8);
+        digest[i * 4 + 3] = static_cast<uint8_t>(state[i]);
+    }
+}
+
+} // namespace gsm
@@ -0,0 +1,232 @@
+/**
+ * @file status.cpp
+ * @brief Shared memory status board.
+ * @author Wilkins White
+ * @copyright 2024 Nova Dynamics LLC
+ */
+
+#include <cstring>
+#include <errno.h>
+
+#include "status.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define NOVAGSM_STATUS_POSIX 1
+#include <atomic>
+#include <fcntl.h>
+#include <new>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace gsm {
+
+StatusBoard::~StatusBoard()
+{
+    close();
+}
+
+#if defined(NOVAGSM_STATUS_POSIX)
+
+/** Identifies a status board segment ("NGSM"). */
+static constexpr uint32_t kStatusMagic = 0x4e47534d;
+
+/** Attempts to read a consistent snapshot before giving up. */
+static constexpr int kReadAttempts = 1000;
+
+struct StatusBoard::Segment {
+    uint32_t magic;
+    uint32_t size;
+    std::atomic<uint32_t> sequence;
+    status_t data;
+};
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2,
+        "the sequence counter must be lock-free to be shared");
+
+int StatusBoard::open(const char *name)
+{
+    if (name == nullptr)
+        return -EINVAL;
+
+    if (segment)
+        return -EALREADY;
+
+    if (strlen(name) >= sizeof(path))
+        return -ENAMETOOLONG;
+
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return -errno;
+
+    if (ftruncate(fd, sizeof(Segment)) < 0) {
+        const int result = -errno;
+        ::close(fd);
+        shm_unlink(name);
+        return result;
+    }
+
+    void *addr = mmap(nullptr, sizeof(Segment),
+            PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    ::close(fd);
+
+    if (addr == MAP_FAILED) {
+        const int result = -errno;
+        shm_unlink(name);
+        return result;
+    }
+
+    segment = new (addr) Segment();
+    segment->size = sizeof(Segment);
+    segment->sequence.store(0, std::memory_order_relaxed);
+    memset(&segment->data, 0, sizeof(status_t));
+
+    // Readers check the magic last
+    std::atomic_thread_fence(std::memory_order_release);
+    segment->magic = kStatusMagic;
+
+    strcpy(path, name);
+    owner = true;
+    return 0;
+}
+
+int StatusBoard::attach(const char *name)
+{
+    if (name == nullptr)
+        return -EINVAL;
+
+    if (segment)
+        return -EALREADY;
+
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0)
+        return -errno;
+
+    struct stat info;
+    if (fstat(fd, &info) < 0 || info.st_size < (off_t) sizeof(Segment)) {
+        ::close(fd);
+        return -EPROTO;
+    }
+
+    void *addr = mmap(nullptr, sizeof(Segment), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if (addr == MAP_FAILED)
+        return -errno;
+
+    Segment *mapped = static_cast<Segment*>(addr);
+    if (mapped->magic != kStatusMagic || mapped->size != sizeof(Segment)) {
+        munmap(addr, sizeof(Segment));
+        return -EPROTO;
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    segment = mapped;
+    owner = false;
+    return 0;
+}
+
+void StatusBoard::close()
+{
+    if (segment == nullptr)
+        return;
+
+    munmap(segment, sizeof(Segment));
+    segment = nullptr;
+
+    if (owner) {
+        shm_unlink(path);
+        owner = false;
+    }
+}
+
+void StatusBoard::publish(const Modem &modem)
+{
+    if (segment == nullptr || !owner)
+        return;
+
+    status_t &data = segment->data;
+    const uint32_t seq = segment->sequence.load(std::memory_order_relaxed);
+
+    // Odd while the snapshot is being written
+    segment->sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    data.count += 1;
+    data.state = static_cast<uint8_t>(modem.status());
+    data.csq = modem.csq();
+    data.creg = modem.creg();
+    data.cereg = modem.cereg();
+    data.cgatt = modem.cgatt();
+    data.rsrp = modem.cpsi().rsrp;
+    data.sinr = modem.cpsi().sinr;
+    strncpy(data.cifsr, modem.cifsr(), sizeof(data.cifsr) - 1);
+    data.cifsr[sizeof(data.cifsr) - 1] = '\0';
+    data.rx_total = modem.rx_total();
+    data.tx_total = modem.tx_total();
+    data.discarded = modem.discarded();
+    data.last_error = modem.last_error();
+
+    segment->sequence.store(seq + 2, std::memory_order_release);
+}
+
+int StatusBoard::read(status_t &status) const
+{
+    if (segment == nullptr)
+        return -ENOTCONN;
+
+    for (int i = 0; i < kReadAttempts; ++i) {
+        const uint32_t before =
+            segment->sequence.load(std::memory_order_acquire);
+
+        if (before & 1)
+            continue;
+
+        memcpy(&status, &segment->data, sizeof(status_t));
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        const uint32_t after =
+            segment->sequence.load(std::memory_order_relaxed);
+
+        if (before == after)
+            return 0;
+    }
+
+    return -EBUSY;
+}
+
+#else
+
+int StatusBoard::open(const char *name)
+{
+    (void) name;
+    return -ENOSYS;
+}
+
+int StatusBoard::attach(const char *name)
+{
+    (void) name;
+    return -ENOSYS;
+}
+
+void StatusBoard::close()
+{
+}
+
+void StatusBoard::publish(const Modem &modem)
+{
+    (void) modem;
+}
+
+int StatusBoard::read(status_t &status) const
+{
+    (void) status;
+    return -ENOTCONN;
+}
+
+#endif
+
+} // namespace gsm
@@ -0,0 +1,240 @@
+/**
+ * @file telemetry.cpp
+ * @brief Columnar telemetry batch codec.
+ * @author Wilkins White
+ * @copyright 2024 Nova Dynamics LLC
+ */
+
+#include <cstring>
+#include <errno.h>
+
+#include "telemetry.h"
+
+namespace gsm {
+
+/** Map signed values to unsigned so small magnitudes stay small. */
+static inline uint32_t zigzag(uint32_t value)
+{
+    return (value << 1) ^ (0u - (value >> 31));
+}
+
+/** Inverse of zigzag(). */
+static inline uint32_t unzigzag(uint32_t value)
+{
+    return (value >> 1) ^ (0u - (value & 1));
+}
+
+/**
+ * @brief Write a varint.
+ *
+ * @param [in,out] p - write position, advanced past the varint.
+ * @param [in] end - end of the buffer.
+ * @param [in] value - value to write.
+ * @return false if the buffer is full.
+ */
+static bool put_varint(uint8_t *&p, const uint8_t *end, uint32_t value)
+{
+    do {
+        if (p >= end)
+            return false;
+
+        uint8_t byte = value & 0x7f;
+        value >>= 7;
+
+        if (value)
+            byte |= 0x80;
+
+        *p++ = byte;
+    } while (value);
+
+    return true;
+}
+
+/**
+ * @brief Read a varint.
+ *
+ * @param [in,out] p - read position, advanced past the varint.
+ * @param [in] end - end of the data.
+ * @param [out] value - value read.
+ * @return false if the varint is truncated or too long.
+ */
+static bool get_varint(const uint8_t *&p, const uint8_t *end, uint32_t &value)
+{
+    value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (p >= end)
+            return false;
+
+        const uint8_t byte = *p++;
+        value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+
+        if ((byte & 0x80) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+Telemetry::Telemetry(
+        uint8_t columns,
+        int32_t *samples,
+        size_t capacity,
+        uint8_t *buffer,
+        size_t size)
+    : column_count(columns),
+      sample_buffer(samples),
+      row_capacity((samples) ? capacity : 0),
+      out_buffer(buffer),
+      out_size((buffer) ? size : 0)
+{
+}
+
+int Telemetry::add(uint32_t timestamp, const int32_t *values)
+{
+    if (values == nullptr && column_count > 0)
+        return -EINVAL;
+
+    if (full())
+        return -ENOBUFS;
+
+    int32_t *row = sample_buffer + rows * (column_count + 1);
+    row[0] = static_cast<int32_t>(timestamp);
+
+    if (column_count > 0)
+        memcpy(row + 1, values, column_count * sizeof(int32_t));
+
+    rows += 1;
+    return 0;
+}
+
+int Telemetry::encode()
+{
+    const size_t stride = column_count + 1;
+    uint8_t *p = out_buffer;
+    const uint8_t *end = out_buffer + out_size;
+
+    if (!put_varint(p, end, column_count) || !put_varint(p, end, rows))
+        return -ENOBUFS;
+
+    // Timestamps - delta of delta
+    uint32_t prev = 0;
+    uint32_t prev_delta = 0;
+    for (size_t i = 0; i < rows; ++i) {
+        const uint32_t t = static_cast<uint32_t>(sample_buffer[i * stride]);
+        const uint32_t delta = t - prev;
+
+        uint32_t value = t;
+        if (i == 1)
+            value = zigzag(delta);
+        else if (i > 1)
+            value = zigzag(delta - prev_delta);
+
+        if (!put_varint(p, end, value))
+            return -ENOBUFS;
+
+        prev = t;
+        prev_delta = delta;
+    }
+
+    // Values - delta per column
+    for (size_t c = 1; c < stride; ++c) {
+        prev = 0;
+        for (size_t i = 0; i < rows; ++i) {
+            const uint32_t v = static_cast<uint32_t>(
+                    sample_buffer[i * stride + c]);
+
+            if (!put_varint(p, end, zigzag(v - prev)))
+                return -ENOBUFS;
+
+            prev = v;
+        }
+    }
+
+    out_count = p - out_buffer;
+    rows = 0;
+    return out_count;
+}
+
+int Telemetry::send(Modem &modem, Priority priority)
+{
+    if (modem.tx_busy())
+        return -EBUSY;
+
+    if (rows == 0)
+        return -ENODATA;
+
+    if (!modem.connected())
+        return -ENOTCONN;
+
+    int result = encode();
+    if (result < 0)
+        return result;
+
+    return modem.send(out_buffer, out_count, priority);
+}
+
+int Telemetry::decode(
+        const uint8_t *data,
+        size_t size,
+        uint8_t columns,
+        uint32_t *timestamps,
+        int32_t *values,
+        size_t capacity)
+{
+    if (data == nullptr || timestamps == nullptr)
+        return -EINVAL;
+
+    if (values == nullptr && columns > 0)
+        return -EINVAL;
+
+    const uint8_t *p = data;
+    const uint8_t *end = data + size;
+    uint32_t header_columns = 0;
+    uint32_t header_rows = 0;
+
+    if (!get_varint(p, end, header_columns))
+        return -EINVAL;
+
+    if (!get_varint(p, end, header_rows))
+        return -EINVAL;
+
+    if (header_columns != columns)
+        return -EINVAL;
+
+    if (header_rows > capacity)
+        return -ENOBUFS;
+
+    uint32_t prev = 0;
+    uint32_t prev_delta = 0;
+    for (size_t i = 0; i < header_rows; ++i) {
+        uint32_t value = 0;
+        if (!get_varint(p, end, value))
+            return -EINVAL;
+
+        uint32_t t = value;
+        if (i == 1)
+            t = prev + unzigzag(value);
+        else if (i > 1)
+            t = prev + prev_delta + unzigzag(value);
+
+        timestamps[i] = t;
+        prev_delta = t - prev;
+        prev = t;
+    }
+
+    for (size_t c = 0; c < columns; ++c) {
+        prev = 0;
+        for (size_t i = 0; i < header_rows; ++i) {
+            uint32_t value = 0;
+            if (!get_varint(p, end, value))
+                return -EINVAL;
+
+            prev += unzigzag(value);
+            values[i * columns + c] = static_cast<int32_t>(prev);
+        }
+    }
+
+    return header_rows;
+}
+
+} // namespace gsm
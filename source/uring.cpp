@@ -0,0 +1,493 @@
+/**
+ * @file uring.cpp
+ * @brief Batched serial I/O for many modems with io_uring.
+ * @author Wilkins White
+ * @copyright 2024 Nova Dynamics LLC
+ */
+
+#include <cstring>
+#include <errno.h>
+
+#include "debug.h"
+#include "uring.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define NOVAGSM_URING 1
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#endif
+
+namespace gsm {
+
+/** Request kinds, stored in the low byte of the user data. */
+static constexpr uint8_t kOpRead = 1;
+static constexpr uint8_t kOpWrite = 2;
+static constexpr uint8_t kOpCancel = 3;
+static constexpr uint8_t kOpTimeout = 4;
+
+/** Offset meaning the current file position. */
+static constexpr uint64_t kStreamPos = static_cast<uint64_t>(-1);
+
+/** User data of the poll() timeout. */
+static constexpr uint64_t kTimeoutUser = kOpTimeout;
+
+UringPool::Slot *UringPool::current = nullptr;
+
+UringPool::~UringPool()
+{
+    close();
+}
+
+context_t UringPool::context(uint32_t (*millis)())
+{
+    context_t ctx = {};
+    ctx.read = read;
+    ctx.write = write;
+    ctx.millis = millis;
+    return ctx;
+}
+
+int UringPool::read(void *data, size_t size)
+{
+    Slot *slot = current;
+    if (slot == nullptr || slot->rx_index >= slot->rx_count)
+        return 0;
+
+    const size_t available = slot->rx_count - slot->rx_index;
+    if (size > available)
+        size = available;
+
+    memcpy(data, slot->rx_buffer + slot->rx_index, size);
+    slot->rx_index += size;
+
+    // Hand the buffer back for the next read
+    if (slot->rx_index == slot->rx_count) {
+        slot->rx_index = 0;
+        slot->rx_count = 0;
+    }
+
+    return size;
+}
+
+int UringPool::write(const void *data, size_t size)
+{
+    Slot *slot = current;
+    if (slot == nullptr)
+        return -1;
+
+    const size_t space = sizeof(slot->tx_buffer) - slot->tx_count;
+    if (size > space)
+        size = space;
+
+    memcpy(slot->tx_buffer + slot->tx_count, data, size);
+    slot->tx_count += size;
+    return size;
+}
+
+void UringPool::process(int slot, Modem &modem)
+{
+    if (slot < 0 || static_cast<size_t>(slot) >= slots.size())
+        return;
+
+    if (slots[slot].fd < 0 || slots[slot].closing)
+        return;
+
+    current = &slots[slot];
+    modem.process();
+    current = nullptr;
+}
+
+int UringPool::error(int slot) const
+{
+    if (slot < 0 || static_cast<size_t>(slot) >= slots.size())
+        return -EINVAL;
+
+    return slots[slot].status;
+}
+
+#if defined(NOVAGSM_URING)
+
+int UringPool::open(size_t count)
+{
+    if (ring_fd >= 0)
+        return -EALREADY;
+
+    if (count == 0)
+        return -EINVAL;
+
+    // A read and a write per slot, plus cancellations and the timeout
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    int fd = syscall(__NR_io_uring_setup, count * 4 + 1, &params);
+    if (fd < 0)
+        return -errno;
+
+    ring_fd = fd;
+
+    sq_map_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    cq_map_size = params.cq_off.cqes
+        + params.cq_entries * sizeof(struct io_uring_cqe);
+
+    const bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single) {
+        if (cq_map_size > sq_map_size)
+            sq_map_size = cq_map_size;
+
+        cq_map_size = sq_map_size;
+    }
+
+    sq_map = mmap(nullptr, sq_map_size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+
+    if (sq_map == MAP_FAILED) {
+        sq_map = nullptr;
+        const int result = -errno;
+        close();
+        return result;
+    }
+
+    if (single) {
+        cq_map = sq_map;
+    }
+    else {
+        cq_map = mmap(nullptr, cq_map_size, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+
+        if (cq_map == MAP_FAILED) {
+            cq_map = nullptr;
+            const int result = -errno;
+            close();
+            return result;
+        }
+    }
+
+    sqe_map_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    sqe_map = mmap(nullptr, sqe_map_size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+
+    if (sqe_map == MAP_FAILED) {
+        sqe_map = nullptr;
+        const int result = -errno;
+        close();
+        return result;
+    }
+
+    uint8_t *sq = static_cast<uint8_t*>(sq_map);
+    sq_head = reinterpret_cast<uint32_t*>(sq + params.sq_off.head);
+    sq_tail = reinterpret_cast<uint32_t*>(sq + params.sq_off.tail);
+    sq_array = reinterpret_cast<uint32_t*>(sq + params.sq_off.array);
+    sq_mask = *reinterpret_cast<uint32_t*>(sq + params.sq_off.ring_mask);
+    sq_entries = params.sq_entries;
+
+    uint8_t *cq = static_cast<uint8_t*>(cq_map);
+    cq_head = reinterpret_cast<uint32_t*>(cq + params.cq_off.head);
+    cq_tail = reinterpret_cast<uint32_t*>(cq + params.cq_off.tail);
+    cq_mask = *reinterpret_cast<uint32_t*>(cq + params.cq_off.ring_mask);
+    cqes = cq + params.cq_off.cqes;
+
+    slots = std::vector<Slot>(count);
+    queued = 0;
+
+    LOG_INFO("io_uring ready (%lu slots, %u entries)\r\n",
+            (unsigned long) count, sq_entries);
+
+    return 0;
+}
+
+void UringPool::close()
+{
+    if (sqe_map)
+        munmap(sqe_map, sqe_map_size);
+
+    if (cq_map && cq_map != sq_map)
+        munmap(cq_map, cq_map_size);
+
+    if (sq_map)
+        munmap(sq_map, sq_map_size);
+
+    // Closing the ring cancels anything still in flight
+    if (ring_fd >= 0)
+        ::close(ring_fd);
+
+    sqe_map = nullptr;
+    cq_map = nullptr;
+    sq_map = nullptr;
+    ring_fd = -1;
+    queued = 0;
+    slots.clear();
+}
+
+bool UringPool::push(
+        uint8_t op,
+        int fd,
+        void *data,
+        size_t size,
+        uint64_t off,
+        uint64_t user)
+{
+    const uint32_t head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+    const uint32_t tail = *sq_tail;
+
+    if (tail - head >= sq_entries)
+        return false;
+
+    const uint32_t index = tail & sq_mask;
+    struct io_uring_sqe *sqe =
+        static_cast<struct io_uring_sqe*>(sqe_map) + index;
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = op;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uintptr_t>(data);
+    sqe->len = size;
+    sqe->off = off;
+    sqe->user_data = user;
+
+    sq_array[index] = index;
+    __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+    queued += 1;
+    return true;
+}
+
+int UringPool::add(int fd)
+{
+    if (ring_fd < 0)
+        return -ENOTCONN;
+
+    for (size_t i = 0; i < slots.size(); ++i) {
+        Slot &slot = slots[i];
+        if (slot.fd >= 0)
+            continue;
+
+        slot.fd = fd;
+        slot.closing = false;
+        slot.reading = false;
+        slot.status = 0;
+        slot.rx_count = 0;
+        slot.rx_index = 0;
+        slot.tx_count = 0;
+        slot.tx_flight = 0;
+        return i;
+    }
+
+    return -ENOSPC;
+}
+
+void UringPool::remove(int index)
+{
+    if (index < 0 || static_cast<size_t>(index) >= slots.size())
+        return;
+
+    Slot &slot = slots[index];
+    if (slot.fd < 0 || slot.closing)
+        return;
+
+    slot.closing = true;
+
+    if (!slot.reading && slot.tx_flight == 0) {
+        slot.fd = -1;
+        return;
+    }
+
+    const uint64_t base = static_cast<uint64_t>(index) << 8;
+
+    // IORING_OP_ASYNC_CANCEL matches requests by user data
+    if (slot.reading) {
+        push(IORING_OP_ASYNC_CANCEL, -1,
+                reinterpret_cast<void*>(base | kOpRead), 0, 0,
+                base | kOpCancel);
+    }
+
+    if (slot.tx_flight > 0) {
+        push(IORING_OP_ASYNC_CANCEL, -1,
+                reinterpret_cast<void*>(base | kOpWrite), 0, 0,
+                base | kOpCancel);
+    }
+}
+
+int UringPool::poll(uint32_t timeout)
+{
+    if (ring_fd < 0)
+        return -ENOTCONN;
+
+    for (size_t i = 0; i < slots.size(); ++i) {
+        Slot &slot = slots[i];
+        if (slot.fd < 0 || slot.closing)
+            continue;
+
+        // A failed port stays idle until remove()
+        if (slot.status != 0)
+            continue;
+
+        const uint64_t base = static_cast<uint64_t>(i) << 8;
+
+        // Read once the driver has consumed the last read
+        if (!slot.reading && slot.rx_count == 0) {
+            if (!push(IORING_OP_READ, slot.fd, slot.rx_buffer,
+                    sizeof(slot.rx_buffer), kStreamPos, base | kOpRead)) {
+                break;
+            }
+
+            slot.reading = true;
+        }
+
+        if (slot.tx_flight == 0 && slot.tx_count > 0) {
+            if (!push(IORING_OP_WRITE, slot.fd, slot.tx_buffer,
+                    slot.tx_count, kStreamPos, base | kOpWrite)) {
+                break;
+            }
+
+            slot.tx_flight = slot.tx_count;
+        }
+    }
+
+    unsigned int wait = 0;
+    unsigned int flags = 0;
+
+    if (timeout > 0) {
+        // Completes after the first completion or when the time is up
+        wait_time[0] = timeout / 1000;
+        wait_time[1] = (timeout % 1000) * 1000000;
+
+        // 'off' is the number of completions that end the timeout
+        if (push(IORING_OP_TIMEOUT, -1, wait_time, 1, 1, kTimeoutUser)) {
+            wait = 1;
+            flags = IORING_ENTER_GETEVENTS;
+        }
+    }
+
+    if (queued > 0 || wait > 0) {
+        int result = syscall(
+                __NR_io_uring_enter, ring_fd, queued, wait, flags, nullptr, 0);
+
+        if (result < 0 && errno != EINTR)
+            return -errno;
+
+        if (result > 0)
+            queued -= result;
+    }
+
+    // Reap
+    int count = 0;
+    uint32_t head = *cq_head;
+    while (head != __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+        const struct io_uring_cqe *cqe =
+            static_cast<const struct io_uring_cqe*>(cqes) + (head & cq_mask);
+
+        complete(cqe->user_data, cqe->res);
+        head += 1;
+        count += 1;
+    }
+
+    __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+    return count;
+}
+
+#else
+
+int UringPool::open(size_t count)
+{
+    (void) count;
+    return -ENOSYS;
+}
+
+void UringPool::close()
+{
+    slots.clear();
+}
+
+bool UringPool::push(
+        uint8_t op,
+        int fd,
+        void *data,
+        size_t size,
+        uint64_t off,
+        uint64_t user)
+{
+    (void) op;
+    (void) fd;
+    (void) data;
+    (void) size;
+    (void) off;
+    (void) user;
+    return false;
+}
+
+int UringPool::add(int fd)
+{
+    (void) fd;
+    return -ENOTCONN;
+}
+
+void UringPool::remove(int index)
+{
+    (void) index;
+}
+
+int UringPool::poll(uint32_t timeout)
+{
+    (void) timeout;
+    return -ENOTCONN;
+}
+
+#endif
+
+void UringPool::complete(uint64_t user, int32_t result)
+{
+    const uint8_t op = user & 0xff;
+    const size_t index = user >> 8;
+
+    if (op == kOpTimeout || op == kOpCancel || index >= slots.size())
+        return;
+
+    Slot &slot = slots[index];
+
+    if (op == kOpRead) {
+        slot.reading = false;
+
+        if (result > 0) {
+            slot.rx_count = result;
+            slot.rx_index = 0;
+        }
+        else if (result == 0) {
+            // The port hung up, e.g. a USB modem was unplugged
+            LOG_ERROR("Slot %lu hung up\r\n", (unsigned long) index);
+            slot.status = -EPIPE;
+        }
+        else if (result < 0 && result != -EAGAIN && result != -EINTR
+                && result != -ECANCELED) {
+            LOG_ERROR("Slot %lu read failed (%d)\r\n",
+                    (unsigned long) index, result);
+
+            slot.status = result;
+        }
+    }
+    else if (op == kOpWrite) {
+        const size_t written = (result > 0) ? result : 0;
+
+        if (result < 0 && result != -EAGAIN && result != -EINTR
+                && result != -ECANCELED) {
+            LOG_ERROR("Slot %lu write failed (%d)\r\n",
+                    (unsigned long) index, result);
+
+            slot.status = result;
+        }
+
+        // Keep whatever was queued behind the write
+        memmove(slot.tx_buffer, slot.tx_buffer + written,
+                slot.tx_count - written);
+
+        slot.tx_count -= written;
+        slot.tx_flight = 0;
+    }
+
+    if (slot.closing && !slot.reading && slot.tx_flight == 0)
+        slot.fd = -1;
+}
+
+} // namespace gsm